@@ -0,0 +1,228 @@
+/*
+ * work_stealing_pool.h
+ *
+ * Work-stealing thread pool implemented using a Chase-Lev deque per worker (stack #8),
+ * a global injection queue (the intrusive queue #9), and an event count that idle
+ * workers park on
+ *
+ * A task submitted by a worker goes to the bottom of the worker's own deque, and the
+ * worker takes its next task from there (LIFO, the most recent task is the one still
+ * in its cache). A task submitted from outside the pool goes to the injection queue.
+ * A worker whose deque is empty takes a task from the injection queue, then steals
+ * from the top of the other deques, starting at a random victim. A worker that keeps
+ * finding nothing parks until the next submit.
+ *
+ * Tasks are callables without arguments and may be move-only. A callable of up to
+ * kSmallSize bytes is stored in the task itself (one allocation per task), a larger
+ * one in an allocation of its own. A task must not throw: an exception leaving it
+ * terminates the program. A task should not block waiting for the tasks it spawns,
+ * fork-join code continues in the task that completes last instead (see the fib
+ * benchmark in main.cpp). The destructor lets the workers run every task submitted
+ * before it, then joins them.
+ *
+ */
+
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+#include <memory> // std::unique_ptr
+#include <utility> // std::forward
+#include <optional> // std::optional
+#include <type_traits> // std::decay_t
+#include <new> // placement new, std::launder
+#include <atomic> // std::atomic
+#include <thread> // std::thread, std::this_thread::get_id
+#include <functional> // std::hash
+#include <algorithm> // std::max
+#include <cstdint> // std::uint32_t
+#include <cstddef> // std::size_t, std::max_align_t
+#include "threadsafe_stack8.h" // ThreadSafeStack8
+#include "threadsafe_queue9.h" // ThreadSafeQueue9, MpscHook
+#include "event_count.h" // EventCount
+
+class WorkStealingPool {
+	static constexpr size_t kNspins = 64; // searches for a task before an idle worker parks
+
+	// Type-erased callable, linked into the injection queue by its hook
+	class Task: public MpscHook {
+	public:
+		static constexpr size_t kSmallSize = 48; // callables stored in the task itself
+
+		template<typename Callable>
+		static Task* create(Callable &&callable);
+		// runs the callable and deletes the task
+		void run() noexcept;
+	private:
+		template<typename Function>
+		static constexpr bool kIsSmall = sizeof(Function) <= kSmallSize
+				&& alignof(Function) <= alignof(std::max_align_t);
+
+		Task() = default;
+
+		void (*m_run)(Task *task);
+		alignas(std::max_align_t) unsigned char m_storage[kSmallSize];
+	};
+
+	struct Worker {
+		ThreadSafeStack8<Task*> deque;
+		std::thread thread;
+	};
+
+	// The worker run by the calling thread and its pool
+	struct LocalWorker {
+		const WorkStealingPool *pool;
+		Worker *worker;
+	};
+public:
+	explicit WorkStealingPool(size_t nworkers =
+			std::thread::hardware_concurrency());
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+	WorkStealingPool(WorkStealingPool&&) = delete;
+	WorkStealingPool& operator=(WorkStealingPool&&) = delete;
+
+	size_t size() const;
+	template<typename Callable>
+	void submit(Callable &&callable);
+private:
+	static LocalWorker& localSlot();
+	static size_t randomIndex(size_t count);
+	Worker* localWorker() const;
+	Task* findTask(Worker *worker);
+	void runWorker(Worker *worker);
+
+	const size_t m_nworkers;
+	std::unique_ptr<Worker[]> m_workers;
+	ThreadSafeQueue9<Task> m_injection;
+	EventCount m_event_count;
+	std::atomic<bool> m_stop;
+};
+
+// Task
+
+template<typename Callable>
+WorkStealingPool::Task* WorkStealingPool::Task::create(Callable &&callable) {
+	typedef std::decay_t<Callable> Function;
+	std::unique_ptr<Task> task(new Task());
+	if constexpr (kIsSmall<Function>) {
+		new (task->m_storage) Function(std::forward<Callable>(callable));
+		task->m_run = [](Task *task) {
+			Function *function = std::launder(
+					reinterpret_cast<Function*>(task->m_storage));
+			(*function)();
+			function->~Function();
+		};
+	} else {
+		new (task->m_storage) Function*(
+				new Function(std::forward<Callable>(callable)));
+		task->m_run = [](Task *task) {
+			std::unique_ptr<Function> function(
+					*std::launder(reinterpret_cast<Function**>(task->m_storage)));
+			(*function)();
+		};
+	}
+	return task.release();
+}
+
+inline void WorkStealingPool::Task::run() noexcept {
+	m_run(this);
+	delete this;
+}
+
+// WorkStealingPool
+
+inline WorkStealingPool::WorkStealingPool(size_t nworkers) :
+		m_nworkers(std::max<size_t>(nworkers, 1)), m_workers(
+				new Worker[m_nworkers]), m_stop(false) {
+	for (size_t ind = 0; ind < m_nworkers; ++ind)
+		m_workers[ind].thread = std::thread(&WorkStealingPool::runWorker, this,
+				&m_workers[ind]);
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+	m_stop.store(true, std::memory_order_release);
+	m_event_count.notifyAll();
+	for (size_t ind = 0; ind < m_nworkers; ++ind)
+		m_workers[ind].thread.join();
+}
+
+inline size_t WorkStealingPool::size() const {
+	return m_nworkers;
+}
+
+template<typename Callable>
+void WorkStealingPool::submit(Callable &&callable) {
+	Task *task = Task::create(std::forward<Callable>(callable));
+	if (Worker *worker = localWorker())
+		worker->deque.push(task);
+	else
+		m_injection.push(*task);
+	m_event_count.notifyOne();
+}
+
+inline WorkStealingPool::LocalWorker& WorkStealingPool::localSlot() {
+	static thread_local LocalWorker s_local { nullptr, nullptr };
+	return s_local;
+}
+
+// Per-thread xorshift sequence, so that the thieves spread over the victims
+inline size_t WorkStealingPool::randomIndex(size_t count) {
+	static thread_local std::uint32_t s_state = static_cast<std::uint32_t>(std::hash<
+			std::thread::id>()(std::this_thread::get_id())) | 1;
+	s_state ^= s_state << 13;
+	s_state ^= s_state >> 17;
+	s_state ^= s_state << 5;
+	return s_state % count;
+}
+
+inline WorkStealingPool::Worker* WorkStealingPool::localWorker() const {
+	const LocalWorker &local = localSlot();
+	return local.pool == this ? local.worker : nullptr;
+}
+
+// Own deque first, then the injection queue, then the other deques; nullptr if all
+// of them were empty (or every steal lost its race)
+inline WorkStealingPool::Task* WorkStealingPool::findTask(Worker *worker) {
+	if (worker)
+		if (std::optional<Task*> task = worker->deque.tryPopValue())
+			return *task;
+	if (Task *task = m_injection.tryPop())
+		return task;
+	const size_t first = randomIndex(m_nworkers);
+	for (size_t ind = 0; ind < m_nworkers; ++ind) {
+		Worker &victim = m_workers[(first + ind) % m_nworkers];
+		if (&victim == worker)
+			continue;
+		if (std::optional<Task*> task = victim.deque.steal())
+			return *task;
+	}
+	return nullptr;
+}
+
+inline void WorkStealingPool::runWorker(Worker *worker) {
+	localSlot() = LocalWorker { this, worker };
+	for (;;) {
+		Task *task = nullptr;
+		for (size_t spin = 0; !task && spin < kNspins; ++spin)
+			task = findTask(worker);
+		if (!task) {
+			// either the search after prepareWait sees a task submitted meanwhile,
+			// or the submit sees this worker waiting and wakes it up
+			const EventCount::Key key = m_event_count.prepareWait();
+			task = findTask(worker);
+			if (!task) {
+				if (m_stop.load(std::memory_order_acquire)) {
+					m_event_count.cancelWait();
+					return;
+				}
+				m_event_count.wait(key);
+				continue;
+			}
+			m_event_count.cancelWait();
+		}
+		task->run();
+	}
+}
+
+#endif /* WORK_STEALING_POOL_H_ */
@@ -0,0 +1,214 @@
+//============================================================================
+// Script for testing the task throughput of the work-stealing thread pool
+//============================================================================
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <cmath>
+#include <atomic>
+#include <optional>
+#include "timer.h"
+#include "threadsafe_queue1.h"
+#include "work_stealing_pool.h"
+using namespace std;
+
+void usageMsg(void) {
+	string separator(50, '-');
+	ostringstream msg;
+	msg << separator << endl;
+	msg << "Usage: ./threadsafe_pool_test kFib kNworkers kNiter" << endl << endl;
+	msg << "Where: " << endl;
+	msg << "kFib = argument of the recursive fibonacci, every call fib(n) with n > 1 spawns a task for fib(n - 1)" << endl;
+	msg << "kNworkers = number of worker threads of the pool" << endl;
+	msg << "kNiter = number of test runs (iterations)" << endl;
+	msg << separator << endl;
+	msg << "aborting.." << endl;
+	cerr << msg.str() << endl;
+	terminate();
+}
+
+// Test parameters
+struct TestParameters {
+	size_t kFib; // argument of the recursive fibonacci
+	size_t kNworkers; // number of worker threads of the pool
+	size_t kNiter; // number of test runs (iterations)
+};
+
+// Hand-rolled pool of workers sharing a single lock-based queue #1 of tasks
+class SharedQueuePool {
+public:
+	explicit SharedQueuePool(size_t nworkers) :
+			m_stop(false) {
+		for (size_t ind = 0; ind < nworkers; ++ind)
+			m_threads.push_back(thread([this]() {
+				while (!m_stop.load(memory_order_acquire))
+					if (optional<function<void()>> task = m_queue.waitPopValueFor(
+							chrono::milliseconds(1)))
+						(*task)();
+			}));
+	}
+	~SharedQueuePool() {
+		m_stop.store(true, memory_order_release);
+		for_each(m_threads.begin(), m_threads.end(), mem_fn(&thread::join));
+	}
+	template<typename Callable>
+	void submit(Callable &&callable) {
+		m_queue.push(function<void()>(std::forward<Callable>(callable)));
+	}
+private:
+	ThreadSafeQueue1<function<void()>> m_queue;
+	vector<thread> m_threads;
+	atomic<bool> m_stop;
+};
+
+// Frame of a call fib(n) with n > 1, its two children add their results to the sum and the
+// child that finishes last passes the sum on to the parent frame (no task waits for another)
+struct FibFrame {
+	FibFrame *parent; // nullptr for the root frame, which the main thread waits on
+	atomic<size_t> sum;
+	atomic<size_t> npending;
+};
+
+// Function to add a finished child's result to its frame, and to complete the frame if the child was the last
+void completeFib(FibFrame *frame, size_t result) {
+	for (;;) {
+		// the parent is read first, once the count reaches zero the main thread may
+		// already be done with the root frame
+		FibFrame *parent = frame->parent;
+		frame->sum.fetch_add(result, memory_order_relaxed);
+		if (frame->npending.fetch_sub(1, memory_order_acq_rel) != 1 || !parent)
+			return;
+		result = frame->sum.load(memory_order_relaxed);
+		delete frame;
+		frame = parent;
+	}
+}
+
+// Function to compute the fibonacci number fib(n) into the parent frame:
+// fib(n - 1) is spawned as a task, fib(n - 2) is computed in place
+template<typename Pool>
+void fib(Pool &pool, size_t n, FibFrame *parent) {
+	while (n > 1) {
+		FibFrame *frame = new FibFrame { parent, { 0 }, { 2 } };
+		pool.submit([&pool, n, frame]() {
+			fib(pool, n - 1, frame);
+		});
+		n -= 2;
+		parent = frame;
+	}
+	completeFib(parent, n);
+}
+
+// Function to count the tasks run for fib(n) (the root task included), that is fib(n + 1)
+size_t countTasks(size_t n) {
+	size_t prev = 0, next = 1; // fib(0), fib(1)
+	for (size_t ind = 0; ind < n; ++ind) {
+		const size_t sum = prev + next;
+		prev = next;
+		next = sum;
+	}
+	return next;
+}
+
+// Function to calculate mean and std dev of test run timings
+string calcMeanStd(const vector<size_t> &results) {
+
+	// mean
+	double sum = std::accumulate(results.begin(), results.end(), 0.0);
+	double mean = sum / results.size();
+
+	// std dev
+	double accum = 0.0;
+	std::for_each(results.begin(), results.end(), [&](const double d) {
+		accum += (d - mean) * (d - mean);
+	});
+	double stdev = sqrt(accum / (results.size() - 1));
+
+	// write to string
+	ostringstream os;
+	os.precision(3);
+	os << mean << " ± " << stdev;
+	return os.str();
+}
+
+// Function to run the test (kNiter runs) for a pool and report the result,
+// the main thread submits fib(kFib) and waits for the root frame to complete
+template<typename Pool>
+void testPool(const string &kName, const TestParameters &kPars) {
+
+	// Timer
+	Timer timer;
+
+	// Print format parameters
+	string separator(50, '-');
+	const size_t kNsetwText = 25;
+	const size_t kNsetwNumber = 10;
+
+	vector<size_t> results; // container of results (timings of all test runs)
+	size_t result = 0;
+
+	for (size_t iterNo = 0; iterNo < kPars.kNiter; ++iterNo) {
+		// the root frame outlives the pool, whose destructor joins the workers
+		FibFrame root { nullptr, { 0 }, { 1 } };
+		Pool pool(kPars.kNworkers);
+
+		timer.start();
+		pool.submit([&pool, &root, &kPars]() {
+			fib(pool, kPars.kFib, &root);
+		});
+		while (root.npending.load(memory_order_acquire))
+			this_thread::yield();
+		timer.stop();
+		result = root.sum.load(memory_order_relaxed);
+		results.push_back(timer.duration());
+	}
+
+	// Report result
+	cout << separator << endl;
+	cout << "Test for " << kName << " (avg of " << kPars.kNiter << " runs)"
+			<< endl;
+
+	cout << left << setw(kNsetwText) << "Size of empty pool: "
+			<< setw(kNsetwNumber) << sizeof(Pool) << " [bytes]" << endl;
+
+	cout << setw(kNsetwText) << "Result: " << setw(kNsetwNumber) << result
+			<< " [-]" << endl;
+
+	cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
+			<< calcMeanStd(results) << " [ms]" << endl;
+
+	const double kMeanDuration = std::accumulate(results.begin(),
+			results.end(), 0.0) / results.size();
+	cout << setw(kNsetwText) << "Tasks per ms: " << setw(kNsetwNumber)
+			<< countTasks(kPars.kFib) / max(kMeanDuration, 1.0) << " [-]" << endl;
+	cout << separator << endl;
+}
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 4)
+		usageMsg();
+
+	// Test parameters
+	const TestParameters kPars { static_cast<size_t>(stoi(string(argv[1]))),
+			static_cast<size_t>(stoi(string(argv[2]))),
+			static_cast<size_t>(stoi(string(argv[3]))) };
+
+	cout << "Fib: " << kPars.kFib << endl;
+	cout << "Nworkers: " << kPars.kNworkers << endl;
+	cout << "Niter: " << kPars.kNiter << endl;
+
+	testPool<SharedQueuePool>("shared queue #1 pool", kPars);
+	testPool<WorkStealingPool>("work-stealing pool", kPars);
+
+	return 0;
+}
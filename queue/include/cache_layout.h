@@ -0,0 +1,48 @@
+/*
+ * cache_layout.h
+ *
+ * Layout policies for the state shared by producers and consumers of a container.
+ * A container aligns the first member of each group of members written by one side
+ * to kLayoutAlignment: PaddedLayout gives each group its own cache line so that
+ * producers and consumers do not false-share, CompactLayout keeps the object small.
+ *
+ */
+
+#ifndef CACHE_LAYOUT_H_
+#define CACHE_LAYOUT_H_
+
+#include <new> // std::hardware_destructive_interference_size
+#include <algorithm> // std::max
+#include <cstddef> // std::size_t
+
+#ifdef __cpp_lib_hardware_interference_size
+// only used for padding inside the containers, not part of an ABI shared between builds
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+inline constexpr size_t kDestructiveInterferenceSize =
+		std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+inline constexpr size_t kDestructiveInterferenceSize = 64;
+#endif
+
+// Members are packed
+struct CompactLayout {
+	static constexpr size_t kAlignment = 1;
+};
+
+// Producer-side and consumer-side members are on separate cache lines
+struct PaddedLayout {
+	static constexpr size_t kAlignment = kDestructiveInterferenceSize;
+};
+
+// Alignment of a member of type T that starts a new group of members
+template<typename Layout, typename T>
+inline constexpr size_t kLayoutAlignment = std::max(alignof(T),
+		Layout::kAlignment);
+
+#endif /* CACHE_LAYOUT_H_ */
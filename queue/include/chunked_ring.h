@@ -0,0 +1,185 @@
+/*
+ * chunked_ring.h
+ *
+ * Growable FIFO storage that holds its elements by value in fixed-size blocks
+ * (about kBlockBytes each) linked from front to back. Elements are pushed at the
+ * back of the back block and popped from the front of the front block; a drained
+ * front block is kept as a spare and reused as the next back block, so a queue that
+ * stays within one block of its size does not allocate. The per-element overhead is
+ * a block link per kBlockElements elements.
+ *
+ * Not thread-safe, the containers guard it with their own lock.
+ *
+ */
+
+#ifndef CHUNKED_RING_H_
+#define CHUNKED_RING_H_
+
+#include <memory> // std::allocator, std::allocator_traits
+#include <type_traits> // std::aligned_storage
+#include <algorithm> // std::max
+#include <new> // placement new
+#include <cstddef> // std::size_t
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ChunkedRing {
+	static constexpr size_t kBlockBytes = 4096;
+	static constexpr size_t kMinBlockElements = 16;
+
+	typedef typename std::aligned_storage<sizeof(Element), alignof(Element)>::type Slot;
+public:
+	static constexpr size_t kBlockElements = std::max(kMinBlockElements,
+			(kBlockBytes - sizeof(void*)) / sizeof(Slot));
+private:
+	struct Block {
+		Block *next;
+		Slot m_slots[kBlockElements];
+		Element* data(size_t ind) {
+			return reinterpret_cast<Element*>(&m_slots[ind]);
+		}
+	};
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Block> BlockAllocator;
+	typedef std::allocator_traits<BlockAllocator> BlockAllocatorTraits;
+public:
+	typedef Allocator allocator_type;
+
+	explicit ChunkedRing(const Allocator &allocator = Allocator());
+	~ChunkedRing();
+	ChunkedRing(const ChunkedRing&) = delete;
+	ChunkedRing& operator=(const ChunkedRing&) = delete;
+	ChunkedRing(ChunkedRing&&) = delete;
+	ChunkedRing& operator=(ChunkedRing&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t size() const;
+	template<typename ...Ts>
+	void emplaceBack(Ts &&... pars);
+	Element& front();
+	void popFront();
+private:
+	Block* acquireBlock();
+	void releaseBlock(Block *block);
+
+	ElementAllocator m_allocator;
+	Block *m_front_block; // null while no block is allocated
+	Block *m_back_block;
+	Block *m_spare_block; // drained block kept for the next growth at the back
+	size_t m_front; // index of the front element in m_front_block
+	size_t m_back; // index one past the back element in m_back_block
+	size_t m_size;
+};
+
+template<typename Element, typename Allocator>
+ChunkedRing<Element, Allocator>::ChunkedRing(const Allocator &allocator) :
+		m_allocator(allocator), m_front_block(nullptr), m_back_block(nullptr), m_spare_block(
+				nullptr), m_front(0), m_back(0), m_size(0) {
+}
+
+template<typename Element, typename Allocator>
+ChunkedRing<Element, Allocator>::~ChunkedRing() {
+	while (m_size)
+		popFront();
+	if (m_front_block)
+		releaseBlock(m_front_block);
+	if (m_spare_block) {
+		BlockAllocator allocator(m_allocator);
+		BlockAllocatorTraits::deallocate(allocator, m_spare_block, 1);
+	}
+}
+
+template<typename Element, typename Allocator>
+typename ChunkedRing<Element, Allocator>::allocator_type ChunkedRing<Element,
+		Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+bool ChunkedRing<Element, Allocator>::empty() const {
+	return !m_size;
+}
+
+template<typename Element, typename Allocator>
+size_t ChunkedRing<Element, Allocator>::size() const {
+	return m_size;
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ChunkedRing<Element, Allocator>::emplaceBack(Ts &&... pars) {
+	if (m_back_block && m_back < kBlockElements) {
+		ElementAllocatorTraits::construct(m_allocator,
+				m_back_block->data(m_back), std::forward<Ts>(pars)...);
+		++m_back;
+	} else {
+		// the new block is only linked once its first element is constructed
+		Block *block = acquireBlock();
+		try {
+			ElementAllocatorTraits::construct(m_allocator, block->data(0),
+					std::forward<Ts>(pars)...);
+		} catch (...) {
+			releaseBlock(block);
+			throw;
+		}
+		if (m_back_block)
+			m_back_block->next = block;
+		else
+			m_front_block = block;
+		m_back_block = block;
+		m_back = 1;
+	}
+	++m_size;
+}
+
+template<typename Element, typename Allocator>
+Element& ChunkedRing<Element, Allocator>::front() {
+	return *m_front_block->data(m_front);
+}
+
+template<typename Element, typename Allocator>
+void ChunkedRing<Element, Allocator>::popFront() {
+	ElementAllocatorTraits::destroy(m_allocator, m_front_block->data(m_front));
+	++m_front;
+	if (!--m_size) {
+		// front and back are in the same block, start over at its beginning
+		// (m_front_block stays allocated until the destructor)
+		m_front = 0;
+		m_back = 0;
+	} else if (m_front == kBlockElements) {
+		Block *next = m_front_block->next;
+		releaseBlock(m_front_block);
+		m_front_block = next;
+		m_front = 0;
+	}
+}
+
+template<typename Element, typename Allocator>
+typename ChunkedRing<Element, Allocator>::Block* ChunkedRing<Element,
+		Allocator>::acquireBlock() {
+	Block *block = m_spare_block;
+	if (block) {
+		m_spare_block = nullptr;
+	} else {
+		BlockAllocator allocator(m_allocator);
+		block = new (BlockAllocatorTraits::allocate(allocator, 1)) Block;
+	}
+	block->next = nullptr;
+	return block;
+}
+
+template<typename Element, typename Allocator>
+void ChunkedRing<Element, Allocator>::releaseBlock(Block *block) {
+	if (!m_spare_block) {
+		m_spare_block = block;
+		return;
+	}
+	BlockAllocator allocator(m_allocator);
+	BlockAllocatorTraits::deallocate(allocator, block, 1);
+}
+
+#endif /* CHUNKED_RING_H_ */
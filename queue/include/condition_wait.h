@@ -0,0 +1,120 @@
+/*
+ * condition_wait.h
+ *
+ * Wait policy for blocking pops built on a mutex and a condition variable.
+ * A consumer that found the container empty registers as a waiter, retries under
+ * the wait mutex and sleeps on the condition variable until a producer notifies it.
+ * Supports deadlines (awaitUntil), unlike EventCount.
+ *
+ * Producers only pay a fence and a load of the waiter count per push, the wait mutex
+ * is taken and the condition variable notified only when a waiter is registered.
+ *
+ */
+
+#ifndef CONDITION_WAIT_H_
+#define CONDITION_WAIT_H_
+
+#include <atomic> // std::atomic, std::atomic_thread_fence
+#include <mutex> // std::mutex, std::lock_guard, std::unique_lock
+#include <condition_variable> // std::condition_variable, std::cv_status
+#include <chrono> // std::chrono::time_point
+#include <cstddef> // std::size_t
+
+class ConditionWait {
+public:
+	static constexpr bool kTimed = true; // awaitUntil is available
+
+	ConditionWait();
+	ConditionWait(const ConditionWait&) = delete;
+	ConditionWait& operator=(const ConditionWait&) = delete;
+	ConditionWait(ConditionWait&&) = delete;
+	ConditionWait& operator=(ConditionWait&&) = delete;
+
+	// producer side, called after an element has been published
+	void notifyOne();
+	void notifyAll();
+
+	// Calls tryPop until it returns a non-empty result (std::optional or pointer),
+	// sleeping between the attempts
+	template<typename TryPop>
+	auto await(TryPop &&tryPop) -> decltype(tryPop());
+	// Same as await, but gives up at the deadline and returns the last (empty) result
+	template<typename Clock, typename Duration, typename TryPop>
+	auto awaitUntil(const std::chrono::time_point<Clock, Duration> &deadline,
+			TryPop &&tryPop) -> decltype(tryPop());
+private:
+	void notify(bool all);
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::atomic<size_t> m_nwaiters; // changed under m_mutex, read by producers without it
+};
+
+inline ConditionWait::ConditionWait() :
+		m_nwaiters(0) {
+}
+
+inline void ConditionWait::notifyOne() {
+	notify(false);
+}
+
+inline void ConditionWait::notifyAll() {
+	notify(true);
+}
+
+inline void ConditionWait::notify(bool all) {
+	// pairs with the fence in await: either the waiter sees the published element
+	// on its retry, or the producer sees the waiter here
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!m_nwaiters.load(std::memory_order_relaxed))
+		return;
+	// passing through the mutex makes sure that the waiter is either asleep
+	// or has not retried yet, so the notification is not lost
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	if (all)
+		m_cond.notify_all();
+	else
+		m_cond.notify_one();
+}
+
+template<typename TryPop>
+auto ConditionWait::await(TryPop &&tryPop) -> decltype(tryPop()) {
+	if (auto result = tryPop())
+		return result;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_nwaiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (;;) {
+		if (auto result = tryPop()) {
+			m_nwaiters.fetch_sub(1, std::memory_order_relaxed);
+			return result;
+		}
+		m_cond.wait(lock);
+	}
+}
+
+template<typename Clock, typename Duration, typename TryPop>
+auto ConditionWait::awaitUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline,
+		TryPop &&tryPop) -> decltype(tryPop()) {
+	if (auto result = tryPop())
+		return result;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_nwaiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (;;) {
+		if (auto result = tryPop()) {
+			m_nwaiters.fetch_sub(1, std::memory_order_relaxed);
+			return result;
+		}
+		if (m_cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+			auto result = tryPop();
+			m_nwaiters.fetch_sub(1, std::memory_order_relaxed);
+			return result;
+		}
+	}
+}
+
+#endif /* CONDITION_WAIT_H_ */
@@ -0,0 +1,218 @@
+/*
+ * epoch_reclamation.h
+ *
+ * Epoch-based reclamation (EBR) domain for safe memory reclamation in the lock-free
+ * containers. Threads register lazily with the domain and announce the global epoch
+ * for the duration of a critical section (Guard). Removed nodes are retired to
+ * per-thread limbo lists tagged with the global epoch, and a limbo list is freed
+ * as a batch once the global epoch has advanced twice past its tag, i.e. once
+ * every thread that could still hold a reference has left its critical section.
+ *
+ * Readers only announce the epoch once per critical section, so traversing nodes
+ * costs no atomic read-modify-write and no per-node store (unlike reference counting
+ * or hazard pointers). Each container owns its own domain, so all nodes still retired
+ * when the container is destroyed are freed by the domain's destructor.
+ *
+ */
+
+#ifndef EPOCH_RECLAMATION_H_
+#define EPOCH_RECLAMATION_H_
+
+#include <memory> // std::default_delete
+#include <vector> // std::vector
+#include <atomic> // std::atomic, std::atomic_thread_fence
+#include <thread> // std::thread::id, std::this_thread::get_id
+#include <cstdint> // std::uint64_t
+
+template<typename T, typename Deleter = std::default_delete<T>>
+class EpochDomain {
+	static constexpr size_t kNepochs = 3; // limbo lists in use: epochs e-2, e-1, e
+	static constexpr size_t kAdvanceInterval = 64; // retires between attempts to advance the epoch
+	static constexpr size_t kActive = 1; // low bit of the announced epoch
+
+	// Per-thread record: announced epoch read by every thread, limbo lists owned by one thread.
+	// Records are never unlinked; a record of a finished thread is adopted by the next
+	// thread that gets the same std::thread::id.
+	struct Record {
+		explicit Record(std::thread::id owner) :
+				m_owner(owner), m_announced(0), m_nretires(0), next(nullptr) {
+			for (size_t ind = 0; ind < kNepochs; ++ind)
+				m_retired_epoch[ind] = 0;
+		}
+		const std::thread::id m_owner;
+		std::atomic<size_t> m_announced;
+		std::vector<T*> m_retired[kNepochs];
+		size_t m_retired_epoch[kNepochs];
+		size_t m_nretires;
+		Record *next;
+	};
+public:
+	// RAII critical section of the calling thread, nodes loaded inside it stay valid
+	// until it ends. A thread must not hold more than one Guard of the same domain at a time.
+	class Guard {
+	public:
+		explicit Guard(EpochDomain &domain);
+		~Guard();
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+		// same interface as HazardPointerDomain::Guard, the slot is not needed
+		T* protect(size_t slot, const std::atomic<T*> &src);
+		void reset(size_t slot);
+		void retire(T *ptr);
+	private:
+		EpochDomain &m_domain;
+		Record *m_record;
+	};
+
+	explicit EpochDomain(const Deleter &deleter = Deleter());
+	~EpochDomain();
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+	EpochDomain(EpochDomain&&) = delete;
+	EpochDomain& operator=(EpochDomain&&) = delete;
+private:
+	Record* acquireRecord();
+	bool tryAdvance(size_t epoch);
+	void reclaim(Record *record, size_t epoch);
+
+	inline static std::atomic<std::uint64_t> s_next_id { 1 };
+
+	std::atomic<size_t> m_epoch;
+	std::atomic<Record*> m_records;
+	Deleter m_deleter;
+	const std::uint64_t m_id;
+};
+
+// Reclamation policy selecting EpochDomain for a container's nodes
+struct EpochReclamation {
+	template<typename T, typename Deleter = std::default_delete<T>>
+	using Domain = EpochDomain<T, Deleter>;
+};
+
+template<typename T, typename Deleter>
+EpochDomain<T, Deleter>::EpochDomain(const Deleter &deleter) :
+		m_epoch(kNepochs), m_records(nullptr), m_deleter(deleter), m_id(
+				s_next_id.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+template<typename T, typename Deleter>
+EpochDomain<T, Deleter>::~EpochDomain() {
+	Record *record = m_records.load(std::memory_order_acquire);
+	while (record) {
+		Record *next = record->next;
+		for (size_t ind = 0; ind < kNepochs; ++ind)
+			for (T *ptr : record->m_retired[ind])
+				m_deleter(ptr);
+		delete record;
+		record = next;
+	}
+}
+
+template<typename T, typename Deleter>
+typename EpochDomain<T, Deleter>::Record* EpochDomain<T, Deleter>::acquireRecord() {
+	// cache of the record used last by this thread, keyed by the domain id
+	// so that a new domain at the address of a destroyed one is never matched
+	static thread_local std::uint64_t s_cached_id = 0;
+	static thread_local Record *s_cached_record = nullptr;
+	if (s_cached_id == m_id)
+		return s_cached_record;
+
+	const std::thread::id owner = std::this_thread::get_id();
+	Record *record = m_records.load(std::memory_order_acquire);
+	while (record && record->m_owner != owner)
+		record = record->next;
+	if (!record) {
+		record = new Record(owner);
+		record->next = m_records.load(std::memory_order_relaxed);
+		while (!m_records.compare_exchange_weak(record->next, record,
+				std::memory_order_release, std::memory_order_relaxed))
+			;
+	}
+	s_cached_id = m_id;
+	s_cached_record = record;
+	return record;
+}
+
+template<typename T, typename Deleter>
+bool EpochDomain<T, Deleter>::tryAdvance(size_t epoch) {
+	// the epoch can only advance once every thread inside a critical section has seen it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (Record *record = m_records.load(std::memory_order_acquire); record;
+			record = record->next) {
+		const size_t announced = record->m_announced.load(
+				std::memory_order_seq_cst);
+		if ((announced & kActive) && (announced >> 1) != epoch)
+			return false;
+	}
+	return m_epoch.compare_exchange_strong(epoch, epoch + 1,
+			std::memory_order_seq_cst);
+}
+
+template<typename T, typename Deleter>
+void EpochDomain<T, Deleter>::reclaim(Record *record, size_t epoch) {
+	for (size_t ind = 0; ind < kNepochs; ++ind) {
+		std::vector<T*> &retired = record->m_retired[ind];
+		if (!retired.empty() && record->m_retired_epoch[ind] + 2 <= epoch) {
+			for (T *ptr : retired)
+				m_deleter(ptr);
+			retired.clear();
+		}
+	}
+}
+
+template<typename T, typename Deleter>
+EpochDomain<T, Deleter>::Guard::Guard(EpochDomain &domain) :
+		m_domain(domain), m_record(domain.acquireRecord()) {
+	size_t epoch = m_domain.m_epoch.load(std::memory_order_relaxed);
+	for (;;) {
+		m_record->m_announced.store((epoch << 1) | kActive,
+				std::memory_order_relaxed);
+		// the announcement must be visible before any node of the container is loaded
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const size_t current = m_domain.m_epoch.load(std::memory_order_acquire);
+		if (current == epoch)
+			break;
+		epoch = current;
+	}
+	m_domain.reclaim(m_record, epoch);
+}
+
+template<typename T, typename Deleter>
+EpochDomain<T, Deleter>::Guard::~Guard() {
+	m_record->m_announced.store(0, std::memory_order_release);
+}
+
+template<typename T, typename Deleter>
+T* EpochDomain<T, Deleter>::Guard::protect(size_t,
+		const std::atomic<T*> &src) {
+	return src.load(std::memory_order_acquire);
+}
+
+template<typename T, typename Deleter>
+void EpochDomain<T, Deleter>::Guard::reset(size_t) {
+}
+
+template<typename T, typename Deleter>
+void EpochDomain<T, Deleter>::Guard::retire(T *ptr) {
+	// tag with the current global epoch: every thread that can still reach ptr
+	// announced this epoch or an earlier one
+	size_t epoch = m_domain.m_epoch.load(std::memory_order_seq_cst);
+	const size_t ind = epoch % kNepochs;
+	if (m_record->m_retired_epoch[ind] != epoch) {
+		// the list still holds nodes of epoch - kNepochs, which are safe to free
+		for (T *retired : m_record->m_retired[ind])
+			m_domain.m_deleter(retired);
+		m_record->m_retired[ind].clear();
+		m_record->m_retired_epoch[ind] = epoch;
+	}
+	m_record->m_retired[ind].push_back(ptr);
+
+	if (++m_record->m_nretires % kAdvanceInterval == 0) {
+		if (m_domain.tryAdvance(epoch))
+			++epoch;
+		m_domain.reclaim(m_record, epoch);
+	}
+}
+
+#endif /* EPOCH_RECLAMATION_H_ */
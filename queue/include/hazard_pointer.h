@@ -0,0 +1,193 @@
+/*
+ * hazard_pointer.h
+ *
+ * Hazard-pointer domain for safe memory reclamation in the lock-free containers.
+ * A thread publishes the nodes it is about to dereference in its hazard slots,
+ * removed nodes are retired to a per-thread list and only handed to the deleter
+ * once no hazard slot of the domain points to them any more.
+ *
+ * Each container owns its own domain, so all nodes still retired when the
+ * container is destroyed are freed by the domain's destructor.
+ *
+ */
+
+#ifndef HAZARD_POINTER_H_
+#define HAZARD_POINTER_H_
+
+#include <memory> // std::default_delete
+#include <vector> // std::vector
+#include <algorithm> // std::sort, std::binary_search, std::partition
+#include <atomic> // std::atomic, std::atomic_thread_fence
+#include <thread> // std::thread::id, std::this_thread::get_id
+#include <cstdint> // std::uint64_t
+
+template<typename T, typename Deleter = std::default_delete<T>,
+		size_t kNslots = 2>
+class HazardPointerDomain {
+	// Per-thread record: hazard slots read by every thread, retire list owned by one thread.
+	// Records are never unlinked; a record of a finished thread is adopted by the next
+	// thread that gets the same std::thread::id.
+	struct Record {
+		explicit Record(std::thread::id owner) :
+				m_owner(owner), next(nullptr) {
+			for (size_t slot = 0; slot < kNslots; ++slot)
+				m_hazards[slot].store(nullptr, std::memory_order_relaxed);
+		}
+		const std::thread::id m_owner;
+		std::atomic<T*> m_hazards[kNslots];
+		std::vector<T*> m_retired;
+		Record *next;
+	};
+public:
+	// RAII access to the calling thread's record, all hazard slots are cleared on destruction.
+	// A thread must not hold more than one Guard of the same domain at a time.
+	class Guard {
+	public:
+		explicit Guard(HazardPointerDomain &domain);
+		~Guard();
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+		T* protect(size_t slot, const std::atomic<T*> &src);
+		void reset(size_t slot);
+		void retire(T *ptr);
+	private:
+		HazardPointerDomain &m_domain;
+		Record *m_record;
+	};
+
+	explicit HazardPointerDomain(const Deleter &deleter = Deleter());
+	~HazardPointerDomain();
+	HazardPointerDomain(const HazardPointerDomain&) = delete;
+	HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
+	HazardPointerDomain(HazardPointerDomain&&) = delete;
+	HazardPointerDomain& operator=(HazardPointerDomain&&) = delete;
+private:
+	Record* acquireRecord();
+	void scan(Record *record);
+
+	inline static std::atomic<std::uint64_t> s_next_id { 1 };
+
+	std::atomic<Record*> m_records;
+	std::atomic<size_t> m_nrecords;
+	Deleter m_deleter;
+	const std::uint64_t m_id;
+};
+
+// Reclamation policy selecting HazardPointerDomain for a container's nodes
+struct HazardPointers {
+	template<typename T, typename Deleter = std::default_delete<T>>
+	using Domain = HazardPointerDomain<T, Deleter>;
+};
+
+template<typename T, typename Deleter, size_t kNslots>
+HazardPointerDomain<T, Deleter, kNslots>::HazardPointerDomain(
+		const Deleter &deleter) :
+		m_records(nullptr), m_nrecords(0), m_deleter(deleter), m_id(
+				s_next_id.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+HazardPointerDomain<T, Deleter, kNslots>::~HazardPointerDomain() {
+	Record *record = m_records.load(std::memory_order_acquire);
+	while (record) {
+		Record *next = record->next;
+		for (T *ptr : record->m_retired)
+			m_deleter(ptr);
+		delete record;
+		record = next;
+	}
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+typename HazardPointerDomain<T, Deleter, kNslots>::Record* HazardPointerDomain<T,
+		Deleter, kNslots>::acquireRecord() {
+	// cache of the record used last by this thread, keyed by the domain id
+	// so that a new domain at the address of a destroyed one is never matched
+	static thread_local std::uint64_t s_cached_id = 0;
+	static thread_local Record *s_cached_record = nullptr;
+	if (s_cached_id == m_id)
+		return s_cached_record;
+
+	const std::thread::id owner = std::this_thread::get_id();
+	Record *record = m_records.load(std::memory_order_acquire);
+	while (record && record->m_owner != owner)
+		record = record->next;
+	if (!record) {
+		record = new Record(owner);
+		record->next = m_records.load(std::memory_order_relaxed);
+		while (!m_records.compare_exchange_weak(record->next, record,
+				std::memory_order_release, std::memory_order_relaxed))
+			;
+		m_nrecords.fetch_add(1, std::memory_order_relaxed);
+	}
+	s_cached_id = m_id;
+	s_cached_record = record;
+	return record;
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+void HazardPointerDomain<T, Deleter, kNslots>::scan(Record *record) {
+	// pairs with the seq_cst store of the hazard slot in protect()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	std::vector<T*> hazards;
+	hazards.reserve(m_nrecords.load(std::memory_order_relaxed) * kNslots);
+	for (Record *other = m_records.load(std::memory_order_acquire); other;
+			other = other->next)
+		for (size_t slot = 0; slot < kNslots; ++slot)
+			if (T *ptr = other->m_hazards[slot].load(std::memory_order_acquire))
+				hazards.push_back(ptr);
+	std::sort(hazards.begin(), hazards.end());
+
+	auto first_free = std::partition(record->m_retired.begin(),
+			record->m_retired.end(), [&hazards](T *ptr) -> bool {
+				return std::binary_search(hazards.begin(), hazards.end(), ptr);
+			});
+	for (auto it = first_free; it != record->m_retired.end(); ++it)
+		m_deleter(*it);
+	record->m_retired.erase(first_free, record->m_retired.end());
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+HazardPointerDomain<T, Deleter, kNslots>::Guard::Guard(
+		HazardPointerDomain &domain) :
+		m_domain(domain), m_record(domain.acquireRecord()) {
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+HazardPointerDomain<T, Deleter, kNslots>::Guard::~Guard() {
+	for (size_t slot = 0; slot < kNslots; ++slot)
+		m_record->m_hazards[slot].store(nullptr, std::memory_order_release);
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+T* HazardPointerDomain<T, Deleter, kNslots>::Guard::protect(size_t slot,
+		const std::atomic<T*> &src) {
+	T *ptr = src.load(std::memory_order_relaxed);
+	for (;;) {
+		m_record->m_hazards[slot].store(ptr, std::memory_order_seq_cst);
+		T *reread = src.load(std::memory_order_seq_cst);
+		if (reread == ptr)
+			return ptr;
+		ptr = reread;
+	}
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+void HazardPointerDomain<T, Deleter, kNslots>::Guard::reset(size_t slot) {
+	m_record->m_hazards[slot].store(nullptr, std::memory_order_release);
+}
+
+template<typename T, typename Deleter, size_t kNslots>
+void HazardPointerDomain<T, Deleter, kNslots>::Guard::retire(T *ptr) {
+	m_record->m_retired.push_back(ptr);
+	// scan once the list outgrows the number of hazard slots, so that every scan
+	// frees at least half of the retired nodes
+	if (m_record->m_retired.size()
+			>= 2 * kNslots * m_domain.m_nrecords.load(std::memory_order_relaxed)
+					+ 16)
+		m_domain.scan(m_record);
+}
+
+#endif /* HAZARD_POINTER_H_ */
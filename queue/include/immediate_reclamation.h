@@ -0,0 +1,75 @@
+/*
+ * immediate_reclamation.h
+ *
+ * Reclamation domain that hands retired nodes to the deleter right away. It has
+ * the same interface as HazardPointerDomain and EpochDomain, and is only safe
+ * when no other thread can still reach a retired node, i.e. when nodes are
+ * unlinked under a lock (ThreadSafeQueue with SingleLock or TwoLocks).
+ *
+ */
+
+#ifndef IMMEDIATE_RECLAMATION_H_
+#define IMMEDIATE_RECLAMATION_H_
+
+#include <memory> // std::default_delete
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+
+template<typename T, typename Deleter = std::default_delete<T>>
+class ImmediateDomain {
+public:
+	// No-op critical section, retire frees the node immediately
+	class Guard {
+	public:
+		explicit Guard(ImmediateDomain &domain);
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+		T* protect(size_t slot, const std::atomic<T*> &src);
+		void reset(size_t slot);
+		void retire(T *ptr);
+	private:
+		ImmediateDomain &m_domain;
+	};
+
+	explicit ImmediateDomain(const Deleter &deleter = Deleter());
+	ImmediateDomain(const ImmediateDomain&) = delete;
+	ImmediateDomain& operator=(const ImmediateDomain&) = delete;
+	ImmediateDomain(ImmediateDomain&&) = delete;
+	ImmediateDomain& operator=(ImmediateDomain&&) = delete;
+private:
+	Deleter m_deleter;
+};
+
+// Reclamation policy selecting ImmediateDomain for a container's nodes
+struct ImmediateReclamation {
+	template<typename T, typename Deleter = std::default_delete<T>>
+	using Domain = ImmediateDomain<T, Deleter>;
+};
+
+template<typename T, typename Deleter>
+ImmediateDomain<T, Deleter>::ImmediateDomain(const Deleter &deleter) :
+		m_deleter(deleter) {
+}
+
+template<typename T, typename Deleter>
+ImmediateDomain<T, Deleter>::Guard::Guard(ImmediateDomain &domain) :
+		m_domain(domain) {
+}
+
+template<typename T, typename Deleter>
+T* ImmediateDomain<T, Deleter>::Guard::protect(size_t,
+		const std::atomic<T*> &src) {
+	return src.load(std::memory_order_acquire);
+}
+
+template<typename T, typename Deleter>
+void ImmediateDomain<T, Deleter>::Guard::reset(size_t) {
+}
+
+template<typename T, typename Deleter>
+void ImmediateDomain<T, Deleter>::Guard::retire(T *ptr) {
+	m_domain.m_deleter(ptr);
+}
+
+#endif /* IMMEDIATE_RECLAMATION_H_ */
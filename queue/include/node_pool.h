@@ -0,0 +1,196 @@
+/*
+ * node_pool.h
+ *
+ * Pool allocator for the nodes of the linked containers. Freed nodes are kept
+ * on a thread-local freelist, so that a node freed by a consumer thread is reused
+ * by that thread without a call into the heap. When a freelist grows beyond two
+ * batches, a batch is handed over to a global overflow list, from which threads
+ * with an empty freelist (typically the producers) refill a whole batch under
+ * a single lock. The overflow list is linked through the first block of each batch,
+ * so that freeing a block never allocates.
+ *
+ * Blocks are only returned to the heap at program exit, one pool exists per block size
+ * and alignment.
+ *
+ */
+
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <memory> // std::allocator
+#include <algorithm> // std::max
+#include <mutex> // std::mutex, std::lock_guard
+#include <atomic> // std::atomic
+#include <new> // ::operator new, std::align_val_t
+#include <cstddef> // std::size_t
+
+template<size_t kBlockSize, size_t kBlockAlign>
+class NodePool {
+	static constexpr size_t kBatchSize = 64; // blocks moved between a freelist and the overflow list
+
+	// Link of a free block, the first block of a batch on the overflow list also links the batches
+	struct FreeBlock {
+		FreeBlock *next;
+		FreeBlock *next_batch;
+		size_t batch_size;
+	};
+	// blocks are allocated large enough to hold the links
+	static constexpr size_t kAllocSize = std::max(kBlockSize, sizeof(FreeBlock));
+	static constexpr size_t kAllocAlign = std::max(kBlockAlign,
+			alignof(FreeBlock));
+
+	// Thread-local freelist, handed over to the overflow list when the thread exits
+	struct LocalList {
+		~LocalList();
+		FreeBlock *m_head = nullptr;
+		size_t m_size = 0;
+	};
+
+	// Global overflow list of freelist chains, the blocks are released at program exit
+	struct OverflowList {
+		~OverflowList();
+		FreeBlock *m_head = nullptr;
+	};
+public:
+	static void* allocate();
+	static void deallocate(void *ptr) noexcept;
+	static size_t upstreamAllocations();
+private:
+	static void* allocateUpstream();
+	static void deallocateUpstream(void *ptr) noexcept;
+	static void pushBatch(FreeBlock *first, size_t size) noexcept;
+
+	inline static thread_local LocalList s_local;
+	inline static std::mutex s_mutex;
+	inline static OverflowList s_overflow;
+	inline static std::atomic<size_t> s_nupstream { 0 };
+};
+
+// Allocator that serves single objects from the NodePool of their size, arrays from std::allocator
+template<typename T>
+class NodePoolAllocator {
+	typedef NodePool<sizeof(T), alignof(T)> Pool;
+public:
+	typedef T value_type;
+
+	NodePoolAllocator() noexcept = default;
+	template<typename U>
+	NodePoolAllocator(const NodePoolAllocator<U>&) noexcept {
+	}
+
+	T* allocate(size_t n);
+	void deallocate(T *ptr, size_t n) noexcept;
+	template<typename U>
+	bool operator==(const NodePoolAllocator<U>&) const noexcept {
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const NodePoolAllocator<U>&) const noexcept {
+		return false;
+	}
+};
+
+template<size_t kBlockSize, size_t kBlockAlign>
+NodePool<kBlockSize, kBlockAlign>::LocalList::~LocalList() {
+	if (m_head)
+		pushBatch(m_head, m_size);
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+NodePool<kBlockSize, kBlockAlign>::OverflowList::~OverflowList() {
+	while (m_head) {
+		FreeBlock *block = m_head;
+		m_head = m_head->next_batch;
+		while (block) {
+			FreeBlock *next = block->next;
+			deallocateUpstream(block);
+			block = next;
+		}
+	}
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+void* NodePool<kBlockSize, kBlockAlign>::allocate() {
+	LocalList &local = s_local;
+	if (!local.m_head) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		FreeBlock *batch = s_overflow.m_head;
+		if (!batch)
+			return allocateUpstream();
+		s_overflow.m_head = batch->next_batch;
+		local.m_head = batch;
+		local.m_size = batch->batch_size;
+	}
+	FreeBlock *block = local.m_head;
+	local.m_head = block->next;
+	--local.m_size;
+	return block;
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+void NodePool<kBlockSize, kBlockAlign>::deallocate(void *ptr) noexcept {
+	LocalList &local = s_local;
+	FreeBlock *block = static_cast<FreeBlock*>(ptr);
+	block->next = local.m_head;
+	local.m_head = block;
+	if (++local.m_size < 2 * kBatchSize)
+		return;
+
+	// hand the most recently freed batch over to the overflow list
+	FreeBlock *first = local.m_head;
+	FreeBlock *last = first;
+	for (size_t ind = 1; ind < kBatchSize; ++ind)
+		last = last->next;
+	local.m_head = last->next;
+	local.m_size -= kBatchSize;
+	last->next = nullptr;
+	pushBatch(first, kBatchSize);
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+size_t NodePool<kBlockSize, kBlockAlign>::upstreamAllocations() {
+	return s_nupstream.load(std::memory_order_relaxed);
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+void* NodePool<kBlockSize, kBlockAlign>::allocateUpstream() {
+	s_nupstream.fetch_add(1, std::memory_order_relaxed);
+	if constexpr (kAllocAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		return ::operator new(kAllocSize, std::align_val_t(kAllocAlign));
+	else
+		return ::operator new(kAllocSize);
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+void NodePool<kBlockSize, kBlockAlign>::deallocateUpstream(void *ptr) noexcept {
+	if constexpr (kAllocAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		::operator delete(ptr, std::align_val_t(kAllocAlign));
+	else
+		::operator delete(ptr);
+}
+
+template<size_t kBlockSize, size_t kBlockAlign>
+void NodePool<kBlockSize, kBlockAlign>::pushBatch(FreeBlock *first,
+		size_t size) noexcept {
+	first->batch_size = size;
+	std::lock_guard<std::mutex> lock(s_mutex);
+	first->next_batch = s_overflow.m_head;
+	s_overflow.m_head = first;
+}
+
+template<typename T>
+T* NodePoolAllocator<T>::allocate(size_t n) {
+	if (n != 1)
+		return std::allocator<T>().allocate(n);
+	return static_cast<T*>(Pool::allocate());
+}
+
+template<typename T>
+void NodePoolAllocator<T>::deallocate(T *ptr, size_t n) noexcept {
+	if (n != 1)
+		std::allocator<T>().deallocate(ptr, n);
+	else
+		Pool::deallocate(ptr);
+}
+
+#endif /* NODE_POOL_H_ */
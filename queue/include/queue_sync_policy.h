@@ -0,0 +1,480 @@
+/*
+ * queue_sync_policy.h
+ *
+ * Synchronisation policies for ThreadSafeQueue. Each policy provides the Core of
+ * the queue: a singly-linked list of nodes whose front node is a dummy node, and the
+ * algorithm that links new nodes at the back and unlinks nodes at the front.
+ *
+ * SingleLock      - one mutex guarding both ends
+ * TwoLocks        - fine-tuned mutexes (front and back mutex)
+ * BasicSingleLock<Lock>, BasicTwoLocks<Lock> - the same with another lock (lock_policy.h)
+ * LockFreeStrict  - lock-free (Michael-Scott), atomic operations with the strict memory models
+ * LockFreeRelaxed - lock-free (Michael-Scott), atomic operations with the relaxed memory models
+ * ExchangePushStrict, ExchangePushRelaxed - wait-free push with a single exchange on the back
+ *                   label, lock-free (Michael-Scott) pop, strict or relaxed memory models
+ *
+ * A Core is instantiated with the queue's Node (atomic next link plus in-place element),
+ * its reclamation Domain, and its Layout. Nodes are allocated and freed by the queue:
+ * the Core takes chains of linked nodes and retires unlinked dummy nodes to the domain.
+ *
+ */
+
+#ifndef QUEUE_SYNC_POLICY_H_
+#define QUEUE_SYNC_POLICY_H_
+
+#include <utility> // std::move
+#include <optional> // std::optional
+#include <atomic> // std::atomic, std::memory_order
+#include <mutex> // std::mutex, std::lock_guard
+#include <type_traits> // std::false_type, std::true_type
+#include <cstddef> // std::size_t
+#include "cache_layout.h" // kLayoutAlignment
+#include "immediate_reclamation.h" // ImmediateReclamation
+#include "lock_policy.h" // McsLock, TicketLock, SpinThenParkLock
+
+// Moves the element out of next, the node after the dummy node front, which then
+// becomes the new dummy node; front is retired
+template<typename Node, typename Guard>
+std::optional<typename Node::value_type> unlinkFront(Guard &guard, Node *front,
+		Node *next) {
+	typedef typename Node::value_type Element;
+	std::optional<Element> front_element(std::move(*next->data()));
+	next->data()->~Element();
+	guard.retire(front);
+	return front_element;
+}
+
+template<typename Lock = std::mutex>
+struct BasicSingleLock {
+	template<typename Node, typename Domain, typename Layout>
+	class Core {
+		typedef typename Node::value_type Element;
+	public:
+		explicit Core(Node *dummy);
+		Core(const Core&) = delete;
+		Core& operator=(const Core&) = delete;
+
+		// dummy node, only while no other thread accesses the queue
+		Node* front() const;
+		bool empty(Domain &domain) const;
+		size_t size(Domain &domain) const;
+		void pushChain(Domain &domain, Node *first, Node *last, size_t count);
+		std::optional<Element> tryPopValue(Domain &domain);
+		template<typename OutputIt>
+		size_t popBulk(Domain &domain, OutputIt out, size_t max_count);
+	private:
+		mutable Lock m_mutex;
+		size_t m_size;
+		Node *m_node_front;
+		Node *m_node_back;
+	};
+};
+
+template<typename Lock = std::mutex>
+struct BasicTwoLocks {
+	template<typename Node, typename Domain, typename Layout>
+	class Core {
+		typedef typename Node::value_type Element;
+	public:
+		explicit Core(Node *dummy);
+		Core(const Core&) = delete;
+		Core& operator=(const Core&) = delete;
+
+		Node* front() const;
+		bool empty(Domain &domain) const;
+		void pushChain(Domain &domain, Node *first, Node *last, size_t count);
+		std::optional<Element> tryPopValue(Domain &domain);
+		template<typename OutputIt>
+		size_t popBulk(Domain &domain, OutputIt out, size_t max_count);
+	private:
+		// consumer state
+		alignas(kLayoutAlignment<Layout, Lock>) mutable Lock m_mutex_front;
+		Node *m_node_front;
+		// producer state
+		alignas(kLayoutAlignment<Layout, Lock>) mutable Lock m_mutex_back;
+		Node *m_node_back;
+	};
+};
+
+typedef BasicSingleLock<> SingleLock;
+typedef BasicTwoLocks<> TwoLocks;
+
+// Memory orders used by the lock-free Core: everything seq_cst
+struct StrictOrdering {
+	static constexpr std::memory_order kAcquire = std::memory_order_seq_cst;
+	static constexpr std::memory_order kRelease = std::memory_order_seq_cst;
+	static constexpr std::memory_order kAcqRel = std::memory_order_seq_cst;
+	static constexpr std::memory_order kRelaxed = std::memory_order_seq_cst;
+};
+
+// Memory orders used by the lock-free Core: acquire-release only where nodes are published
+struct RelaxedOrdering {
+	static constexpr std::memory_order kAcquire = std::memory_order_acquire;
+	static constexpr std::memory_order kRelease = std::memory_order_release;
+	static constexpr std::memory_order kAcqRel = std::memory_order_acq_rel;
+	static constexpr std::memory_order kRelaxed = std::memory_order_relaxed;
+};
+
+// Nodes unlinked by the lock-free Core may still be read by other threads
+template<typename Domain>
+struct IsImmediateDomain: std::false_type {
+};
+template<typename T, typename Deleter>
+struct IsImmediateDomain<ImmediateDomain<T, Deleter>> : std::true_type {
+};
+
+template<typename Ordering>
+struct LockFree {
+	template<typename Node, typename Domain, typename Layout>
+	class Core {
+		typedef typename Node::value_type Element;
+		static_assert(!IsImmediateDomain<Domain>::value,
+				"The lock-free queue needs deferred reclamation (HazardPointers or EpochReclamation)");
+	public:
+		explicit Core(Node *dummy);
+		Core(const Core&) = delete;
+		Core& operator=(const Core&) = delete;
+
+		Node* front() const;
+		bool empty(Domain &domain) const;
+		void pushChain(Domain &domain, Node *first, Node *last, size_t count);
+		std::optional<Element> tryPopValue(Domain &domain);
+		template<typename OutputIt>
+		size_t popBulk(Domain &domain, OutputIt out, size_t max_count);
+	private:
+		// written by producers and consumers respectively, PaddedLayout puts them on separate cache lines
+		alignas(kLayoutAlignment<Layout, std::atomic<Node*>>) std::atomic<Node*> m_label_back;
+		alignas(kLayoutAlignment<Layout, std::atomic<Node*>>) std::atomic<Node*> m_label_front;
+	};
+};
+
+typedef LockFree<StrictOrdering> LockFreeStrict;
+typedef LockFree<RelaxedOrdering> LockFreeRelaxed;
+
+// A producer swaps the back label to its last node and then links the previous back
+// node to its first node (an atomic store with release, the element is published
+// with it), so push never retries. Until the link is stored the chain is cut after the
+// previous back node: consumers see the queue end there, and the elements pushed
+// later become visible once the producer resumes.
+template<typename Ordering>
+struct ExchangePush {
+	template<typename Node, typename Domain, typename Layout>
+	class Core {
+		typedef typename Node::value_type Element;
+		static_assert(!IsImmediateDomain<Domain>::value,
+				"The lock-free queue needs deferred reclamation (HazardPointers or EpochReclamation)");
+	public:
+		explicit Core(Node *dummy);
+		Core(const Core&) = delete;
+		Core& operator=(const Core&) = delete;
+
+		Node* front() const;
+		bool empty(Domain &domain) const;
+		void pushChain(Domain &domain, Node *first, Node *last, size_t count);
+		std::optional<Element> tryPopValue(Domain &domain);
+		template<typename OutputIt>
+		size_t popBulk(Domain &domain, OutputIt out, size_t max_count);
+	private:
+		alignas(kLayoutAlignment<Layout, std::atomic<Node*>>) std::atomic<Node*> m_label_back;
+		alignas(kLayoutAlignment<Layout, std::atomic<Node*>>) std::atomic<Node*> m_label_front;
+	};
+};
+
+typedef ExchangePush<StrictOrdering> ExchangePushStrict;
+typedef ExchangePush<RelaxedOrdering> ExchangePushRelaxed;
+
+// BasicSingleLock
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+BasicSingleLock<Lock>::Core<Node, Domain, Layout>::Core(Node *dummy) :
+		m_size(0), m_node_front(dummy), m_node_back(dummy) {
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+Node* BasicSingleLock<Lock>::Core<Node, Domain, Layout>::front() const {
+	return m_node_front;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+bool BasicSingleLock<Lock>::Core<Node, Domain, Layout>::empty(Domain&) const {
+	std::lock_guard<Lock> lock(m_mutex);
+	return m_size == 0;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+size_t BasicSingleLock<Lock>::Core<Node, Domain, Layout>::size(Domain&) const {
+	std::lock_guard<Lock> lock(m_mutex);
+	return m_size;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+void BasicSingleLock<Lock>::Core<Node, Domain, Layout>::pushChain(Domain&, Node *first,
+		Node *last, size_t count) {
+	std::lock_guard<Lock> lock(m_mutex);
+	m_node_back->next.store(first, std::memory_order_relaxed);
+	m_node_back = last;
+	m_size += count;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+std::optional<typename Node::value_type> BasicSingleLock<Lock>::Core<Node, Domain, Layout>::tryPopValue(
+		Domain &domain) {
+	typename Domain::Guard guard(domain);
+	std::lock_guard<Lock> lock(m_mutex);
+	Node *old_front = m_node_front;
+	Node *next = old_front->next.load(std::memory_order_relaxed);
+	if (!next)
+		return std::nullopt;
+	m_node_front = next;
+	--m_size;
+	return unlinkFront(guard, old_front, next);
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+template<typename OutputIt>
+size_t BasicSingleLock<Lock>::Core<Node, Domain, Layout>::popBulk(Domain &domain,
+		OutputIt out, size_t max_count) {
+	typename Domain::Guard guard(domain);
+	std::lock_guard<Lock> lock(m_mutex);
+	size_t count = 0;
+	for (; count < max_count; ++count) {
+		Node *old_front = m_node_front;
+		Node *next = old_front->next.load(std::memory_order_relaxed);
+		if (!next)
+			break;
+		m_node_front = next;
+		*out = std::move(*unlinkFront(guard, old_front, next));
+		++out;
+	}
+	m_size -= count;
+	return count;
+}
+
+// BasicTwoLocks
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::Core(Node *dummy) :
+		m_node_front(dummy), m_node_back(dummy) {
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+Node* BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::front() const {
+	return m_node_front;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+bool BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::empty(Domain&) const {
+	std::lock_guard<Lock> lock_front(m_mutex_front);
+	return !m_node_front->next.load(std::memory_order_acquire);
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+void BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::pushChain(Domain&, Node *first,
+		Node *last, size_t) {
+	std::lock_guard<Lock> lock_back(m_mutex_back);
+	// the consumer may be reading next of the same node when the queue is empty
+	m_node_back->next.store(first, std::memory_order_release);
+	m_node_back = last;
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+std::optional<typename Node::value_type> BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::tryPopValue(
+		Domain &domain) {
+	typename Domain::Guard guard(domain);
+	std::lock_guard<Lock> lock_front(m_mutex_front);
+	Node *old_front = m_node_front;
+	Node *next = old_front->next.load(std::memory_order_acquire);
+	if (!next)
+		return std::nullopt;
+	m_node_front = next;
+	return unlinkFront(guard, old_front, next);
+}
+
+template<typename Lock>
+template<typename Node, typename Domain, typename Layout>
+template<typename OutputIt>
+size_t BasicTwoLocks<Lock>::Core<Node, Domain, Layout>::popBulk(Domain &domain,
+		OutputIt out, size_t max_count) {
+	typename Domain::Guard guard(domain);
+	std::lock_guard<Lock> lock_front(m_mutex_front);
+	size_t count = 0;
+	for (; count < max_count; ++count) {
+		Node *old_front = m_node_front;
+		Node *next = old_front->next.load(std::memory_order_acquire);
+		if (!next)
+			break;
+		m_node_front = next;
+		*out = std::move(*unlinkFront(guard, old_front, next));
+		++out;
+	}
+	return count;
+}
+
+// LockFree
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+LockFree<Ordering>::Core<Node, Domain, Layout>::Core(Node *dummy) :
+		m_label_back(dummy), m_label_front(dummy) {
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+Node* LockFree<Ordering>::Core<Node, Domain, Layout>::front() const {
+	return m_label_front.load(std::memory_order_relaxed);
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+bool LockFree<Ordering>::Core<Node, Domain, Layout>::empty(
+		Domain &domain) const {
+	typename Domain::Guard guard(domain);
+	return !guard.protect(0, m_label_front)->next.load(Ordering::kAcquire);
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+void LockFree<Ordering>::Core<Node, Domain, Layout>::pushChain(Domain &domain,
+		Node *first, Node *last, size_t) {
+	typename Domain::Guard guard(domain);
+	for (;;) {
+		Node *old_back = guard.protect(0, m_label_back);
+		Node *next = old_back->next.load(Ordering::kAcquire);
+		if (!next) {
+			// link the chain after the last node, then try to swing the back label
+			if (old_back->next.compare_exchange_weak(next, first,
+					Ordering::kRelease, Ordering::kRelaxed)) {
+				m_label_back.compare_exchange_strong(old_back, last,
+						Ordering::kRelease, Ordering::kRelaxed);
+				return;
+			}
+		} else {
+			// back label is lagging behind, help to advance it
+			m_label_back.compare_exchange_weak(old_back, next,
+					Ordering::kRelease, Ordering::kRelaxed);
+		}
+	}
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+std::optional<typename Node::value_type> LockFree<Ordering>::Core<Node, Domain,
+		Layout>::tryPopValue(Domain &domain) {
+	typename Domain::Guard guard(domain);
+	for (;;) {
+		Node *front_node = guard.protect(0, m_label_front);
+		Node *next = guard.protect(1, front_node->next);
+		if (front_node != m_label_front.load(Ordering::kAcquire))
+			continue;
+		if (!next)
+			return std::nullopt;
+		Node *back_node = m_label_back.load(Ordering::kAcquire);
+		if (front_node == back_node) {
+			// back label is lagging behind, help to advance it before passing it
+			m_label_back.compare_exchange_weak(back_node, next,
+					Ordering::kRelease, Ordering::kRelaxed);
+			continue;
+		}
+		// next is the new dummy node, only the winner of the CAS takes its element
+		if (m_label_front.compare_exchange_weak(front_node, next,
+				Ordering::kAcqRel, Ordering::kRelaxed))
+			return unlinkFront(guard, front_node, next);
+	}
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+template<typename OutputIt>
+size_t LockFree<Ordering>::Core<Node, Domain, Layout>::popBulk(Domain &domain,
+		OutputIt out, size_t max_count) {
+	size_t count = 0;
+	for (; count < max_count; ++count) {
+		std::optional<Element> front_element(tryPopValue(domain));
+		if (!front_element)
+			break;
+		*out = std::move(*front_element);
+		++out;
+	}
+	return count;
+}
+
+// ExchangePush
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+ExchangePush<Ordering>::Core<Node, Domain, Layout>::Core(Node *dummy) :
+		m_label_back(dummy), m_label_front(dummy) {
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+Node* ExchangePush<Ordering>::Core<Node, Domain, Layout>::front() const {
+	return m_label_front.load(std::memory_order_relaxed);
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+bool ExchangePush<Ordering>::Core<Node, Domain, Layout>::empty(
+		Domain &domain) const {
+	typename Domain::Guard guard(domain);
+	return !guard.protect(0, m_label_front)->next.load(Ordering::kAcquire);
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+void ExchangePush<Ordering>::Core<Node, Domain, Layout>::pushChain(Domain&,
+		Node *first, Node *last, size_t) {
+	// the previous back node cannot be popped (nor freed) before it is linked,
+	// a consumer only passes a node whose next link is set
+	Node *old_back = m_label_back.exchange(last, Ordering::kAcqRel);
+	old_back->next.store(first, Ordering::kRelease);
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+std::optional<typename Node::value_type> ExchangePush<Ordering>::Core<Node,
+		Domain, Layout>::tryPopValue(Domain &domain) {
+	typename Domain::Guard guard(domain);
+	for (;;) {
+		Node *front_node = guard.protect(0, m_label_front);
+		Node *next = guard.protect(1, front_node->next);
+		if (front_node != m_label_front.load(Ordering::kAcquire))
+			continue;
+		if (!next)
+			return std::nullopt;
+		// the back label never lags behind, there is nothing to help with
+		if (m_label_front.compare_exchange_weak(front_node, next,
+				Ordering::kAcqRel, Ordering::kRelaxed))
+			return unlinkFront(guard, front_node, next);
+	}
+}
+
+template<typename Ordering>
+template<typename Node, typename Domain, typename Layout>
+template<typename OutputIt>
+size_t ExchangePush<Ordering>::Core<Node, Domain, Layout>::popBulk(
+		Domain &domain, OutputIt out, size_t max_count) {
+	size_t count = 0;
+	for (; count < max_count; ++count) {
+		std::optional<Element> front_element(tryPopValue(domain));
+		if (!front_element)
+			break;
+		*out = std::move(*front_element);
+		++out;
+	}
+	return count;
+}
+
+#endif /* QUEUE_SYNC_POLICY_H_ */
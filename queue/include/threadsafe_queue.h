@@ -0,0 +1,433 @@
+/*
+ * threadsafe_queue.h
+ *
+ * Policy-based thread-safe unbounded queue implemented using a singly-linked list
+ * of nodes that hold their element in place (a single allocation per push).
+ * The strategies are selected at compile time:
+ *
+ * SyncPolicy    - SingleLock, TwoLocks, LockFreeStrict, LockFreeRelaxed, ExchangePushStrict,
+ *                 ExchangePushRelaxed (queue_sync_policy.h);
+ *                 BasicSingleLock<Lock> and BasicTwoLocks<Lock> take a lock from lock_policy.h
+ * ReclaimPolicy - ImmediateReclamation (lock-based only), HazardPointers, EpochReclamation
+ * AllocPolicy   - any standard allocator of Element, e.g. std::allocator, NodePoolAllocator,
+ *                 std::pmr::polymorphic_allocator
+ * WaitPolicy    - ConditionWait (supports deadlines), EventCount (spins, then parks)
+ * Layout        - CompactLayout, PaddedLayout
+ *
+ * ThreadSafeQueue2-4 are aliases for fixed combinations of these policies
+ * (ThreadSafeQueue1 keeps its elements in a chunked ring instead of nodes).
+ *
+ * The nodes are allocated with the AllocPolicy rebound to the node type, and the elements
+ * are constructed with allocator_traits::construct, so an allocator that propagates
+ * itself to the element (uses-allocator construction, e.g. std::pmr::polymorphic_allocator
+ * with std::pmr::string elements) places both in the same memory resource.
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE_H_
+#define THREADSAFE_QUEUE_H_
+
+#include <memory> // std::unique_ptr, std::allocator_traits
+#include <utility> // std::move, std::in_place
+#include <optional> // std::optional
+#include <type_traits> // std::aligned_storage
+#include <new> // placement new
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::duration, std::chrono::time_point, std::chrono::steady_clock
+#include <exception> // std::exception
+#include "queue_sync_policy.h" // SingleLock, TwoLocks, LockFreeStrict, LockFreeRelaxed, ExchangePushStrict, ExchangePushRelaxed
+#include "immediate_reclamation.h" // ImmediateReclamation
+#include "hazard_pointer.h" // HazardPointers
+#include "epoch_reclamation.h" // EpochReclamation
+#include "node_pool.h" // NodePoolAllocator
+#include "condition_wait.h" // ConditionWait
+#include "event_count.h" // EventCount
+#include "cache_layout.h" // CompactLayout, PaddedLayout
+
+template<typename Element, typename SyncPolicy = TwoLocks,
+		typename ReclaimPolicy = ImmediateReclamation,
+		typename AllocPolicy = NodePoolAllocator<Element>,
+		typename WaitPolicy = ConditionWait, typename Layout = CompactLayout>
+class ThreadSafeQueue {
+	typedef std::unique_ptr<Element> ElementPtr;
+	struct Node; // forward declaration
+	typedef typename std::allocator_traits<AllocPolicy>::template rebind_alloc<
+			Node> NodeAllocator;
+	typedef std::allocator_traits<NodeAllocator> NodeAllocatorTraits;
+	typedef typename std::allocator_traits<AllocPolicy>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+
+	// Frees nodes that hold no element, the reclamation domain calls it for retired nodes
+	class NodeDeleter {
+	public:
+		explicit NodeDeleter(const NodeAllocator &allocator);
+		void operator()(Node *node);
+	private:
+		NodeAllocator m_allocator;
+	};
+
+	typedef typename ReclaimPolicy::template Domain<Node, NodeDeleter> Domain;
+	typedef typename SyncPolicy::template Core<Node, Domain, Layout> Core;
+
+	struct EmptyQueue: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty Queue";
+		}
+	};
+
+	// The element is constructed in place in the node by the queue (a single allocation
+	// per push), the front node is a dummy node that holds no element.
+	struct Node {
+		typedef Element value_type;
+
+		Node() :
+				next(nullptr) {
+		}
+		~Node() = default;
+		Element* data() {
+			return reinterpret_cast<Element*>(&m_storage);
+		}
+		std::atomic<Node*> next;
+		typename std::aligned_storage<sizeof(Element), alignof(Element)>::type m_storage;
+	};
+public:
+	typedef AllocPolicy allocator_type;
+
+	ThreadSafeQueue();
+	explicit ThreadSafeQueue(const AllocPolicy &allocator);
+	~ThreadSafeQueue();
+	ThreadSafeQueue(const ThreadSafeQueue&) = delete;
+	ThreadSafeQueue& operator=(const ThreadSafeQueue&) = delete;
+	ThreadSafeQueue(ThreadSafeQueue&&) = delete;
+	ThreadSafeQueue& operator=(ThreadSafeQueue&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	// only for sync policies that keep a count (SingleLock)
+	size_t size() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	template<typename InputIt>
+	void pushBulk(InputIt first, InputIt last);
+
+	ElementPtr waitPop();
+	template<typename Rep, typename Period>
+	ElementPtr waitPopFor(const std::chrono::duration<Rep, Period> &timeout)
+			requires WaitPolicy::kTimed;
+	template<typename Clock, typename Duration>
+	ElementPtr waitPopUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline)
+					requires WaitPolicy::kTimed;
+	ElementPtr tryPop();
+
+	Element waitPopValue();
+	template<typename Rep, typename Period>
+	std::optional<Element> waitPopValueFor(
+			const std::chrono::duration<Rep, Period> &timeout)
+					requires WaitPolicy::kTimed;
+	template<typename Clock, typename Duration>
+	std::optional<Element> waitPopValueUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline)
+					requires WaitPolicy::kTimed;
+	std::optional<Element> tryPopValue();
+	template<typename OutputIt>
+	size_t popBulk(OutputIt out, size_t max_count);
+private:
+	Node* createNode();
+	template<typename ...Ts>
+	Node* createNode(std::in_place_t, Ts &&... pars);
+	void destroyNode(Node *node);
+	void destroyElementNode(Node *node);
+	void pushChain(Node *first, Node *last, size_t count);
+	void notify(size_t count);
+
+	NodeAllocator m_allocator;
+	mutable Domain m_domain;
+	mutable Core m_core;
+	// waiter state: written only by consumers that go to sleep, read by every producer
+	alignas(kLayoutAlignment<Layout, WaitPolicy>) WaitPolicy m_waiter;
+};
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy, WaitPolicy,
+		Layout>::NodeDeleter::NodeDeleter(const NodeAllocator &allocator) :
+		m_allocator(allocator) {
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::NodeDeleter::operator()(Node *node) {
+	node->~Node();
+	NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy, WaitPolicy,
+		Layout>::ThreadSafeQueue() :
+		ThreadSafeQueue(AllocPolicy()) {
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy, WaitPolicy,
+		Layout>::ThreadSafeQueue(const AllocPolicy &allocator) :
+		m_allocator(allocator), m_domain(NodeDeleter(m_allocator)), m_core(
+				createNode()) {
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy, WaitPolicy,
+		Layout>::~ThreadSafeQueue() {
+	Node *node = m_core.front();
+	Node *next = node->next.load(std::memory_order_relaxed);
+	destroyNode(node);
+	node = next;
+	while (node) {
+		next = node->next.load(std::memory_order_relaxed);
+		destroyElementNode(node);
+		node = next;
+	}
+}
+
+// Creates a dummy node
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::Node* ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::createNode() {
+	Node *node = NodeAllocatorTraits::allocate(m_allocator, 1);
+	new (node) Node();
+	return node;
+}
+
+// Creates a node holding the element constructed from pars
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename ...Ts>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::Node* ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::createNode(
+		std::in_place_t, Ts &&... pars) {
+	Node *node = createNode();
+	try {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::construct(allocator, node->data(),
+				std::forward<Ts>(pars)...);
+	} catch (...) {
+		destroyNode(node);
+		throw;
+	}
+	return node;
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::destroyNode(Node *node) {
+	node->~Node();
+	NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::destroyElementNode(Node *node) {
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::destroy(allocator, node->data());
+	destroyNode(node);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::allocator_type ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+bool ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::empty() const {
+	return m_core.empty(m_domain);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+size_t ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::size() const {
+	return m_core.size(m_domain);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::push(const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::push(Element &&element) {
+	emplace(std::move(element));
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename ...Ts>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::emplace(Ts &&... pars) {
+	Node *new_node = createNode(std::in_place, std::forward<Ts>(pars)...);
+	pushChain(new_node, new_node, 1);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename InputIt>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::pushBulk(InputIt first, InputIt last) {
+	// allocate and link the nodes outside the queue, then publish the chain at once
+	Node *chain_first = nullptr;
+	Node *chain_last = nullptr;
+	size_t count = 0;
+	try {
+		for (; first != last; ++first, ++count) {
+			Node *new_node = createNode(std::in_place, *first);
+			if (chain_last)
+				chain_last->next.store(new_node, std::memory_order_relaxed);
+			else
+				chain_first = new_node;
+			chain_last = new_node;
+		}
+	} catch (...) {
+		while (chain_first) {
+			Node *next = chain_first->next.load(std::memory_order_relaxed);
+			destroyElementNode(chain_first);
+			chain_first = next;
+		}
+		throw;
+	}
+	if (count)
+		pushChain(chain_first, chain_last, count);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::pushChain(Node *first, Node *last, size_t count) {
+	m_core.pushChain(m_domain, first, last, count);
+	notify(count);
+}
+
+// Wakes up to count waiting threads with a single notification
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+void ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::notify(size_t count) {
+	if (count == 1)
+		m_waiter.notifyOne();
+	else if (count > 1)
+		m_waiter.notifyAll();
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::ElementPtr ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename Rep, typename Period>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::ElementPtr ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::waitPopFor(
+		const std::chrono::duration<Rep, Period> &timeout)
+				requires WaitPolicy::kTimed {
+	return waitPopUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+// Returns a null pointer if the queue is still empty at the deadline
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename Clock, typename Duration>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::ElementPtr ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::waitPopUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline)
+				requires WaitPolicy::kTimed {
+	std::optional<Element> front_element(waitPopValueUntil(deadline));
+	if (!front_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*front_element));
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+typename ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::ElementPtr ThreadSafeQueue<Element, SyncPolicy,
+		ReclaimPolicy, AllocPolicy, WaitPolicy, Layout>::tryPop() {
+	std::optional<Element> front_element(tryPopValue());
+	if (!front_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*front_element));
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+Element ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::waitPopValue() {
+	return std::move(*m_waiter.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename Rep, typename Period>
+std::optional<Element> ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy,
+		AllocPolicy, WaitPolicy, Layout>::waitPopValueFor(
+		const std::chrono::duration<Rep, Period> &timeout)
+				requires WaitPolicy::kTimed {
+	return waitPopValueUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+// Returns an empty optional if the queue is still empty at the deadline
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename Clock, typename Duration>
+std::optional<Element> ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy,
+		AllocPolicy, WaitPolicy, Layout>::waitPopValueUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline)
+				requires WaitPolicy::kTimed {
+	return m_waiter.awaitUntil(deadline, [this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	});
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+std::optional<Element> ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy,
+		AllocPolicy, WaitPolicy, Layout>::tryPopValue() {
+	return m_core.tryPopValue(m_domain);
+}
+
+template<typename Element, typename SyncPolicy, typename ReclaimPolicy,
+		typename AllocPolicy, typename WaitPolicy, typename Layout>
+template<typename OutputIt>
+size_t ThreadSafeQueue<Element, SyncPolicy, ReclaimPolicy, AllocPolicy,
+		WaitPolicy, Layout>::popBulk(OutputIt out, size_t max_count) {
+	return m_core.popBulk(m_domain, out, max_count);
+}
+
+#endif /* THREADSAFE_QUEUE_H_ */
@@ -1,26 +1,35 @@
 /*
  * threadsafe_queue1.h
  *
- * Lock-based thread-safe unbounded queue implemented using library queue,
+ * Lock-based thread-safe unbounded queue implemented using a chunked ring buffer,
  * locks, a single mutex, and a condition variable.
  *
+ * The elements are held by value in blocks of ChunkedRing (chunked_ring.h), which
+ * allocates one block per ChunkedRing::kBlockElements pushes instead of one node
+ * per push, and recycles drained blocks. Lock replaces std::mutex by a lock of
+ * lock_policy.h (the waiting pops then use std::condition_variable_any).
+ *
  */
 
 #ifndef THREADSAFE_QUEUE1_H_
 #define THREADSAFE_QUEUE1_H_
 
-#include <queue> // std::queue
-#include <memory> // std::unique_ptr
-#include <list> // std::list
+#include <memory> // std::unique_ptr, std::allocator
 #include <utility> // std::move
+#include <optional> // std::optional
+#include <algorithm> // std::min
 #include <mutex> // std::mutex, std::lock_guard, std::unique_lock
-#include <condition_variable> // std::condition_variable
+#include <condition_variable> // std::condition_variable, std::condition_variable_any
+#include <chrono> // std::chrono::duration, std::chrono::time_point, std::chrono::steady_clock
 #include <exception> // std::exception
+#include "chunked_ring.h" // ChunkedRing
+#include "lock_policy.h" // ConditionVariableFor
 
-template<typename Element>
+template<typename Element, typename Allocator = std::allocator<Element>,
+		typename Lock = std::mutex>
 class ThreadSafeQueue1 {
 	typedef std::unique_ptr<Element> ElementPtr;
-	typedef std::list<ElementPtr> Container;
+	typedef ChunkedRing<Element, Allocator> Container;
 
 	struct EmptyQueue: public std::exception {
 		virtual const char* what() const noexcept (true) override {
@@ -28,98 +37,239 @@ class ThreadSafeQueue1 {
 		}
 	};
 public:
+	typedef Allocator allocator_type;
+
 	ThreadSafeQueue1();
+	explicit ThreadSafeQueue1(const Allocator &allocator);
 	~ThreadSafeQueue1();
 	ThreadSafeQueue1(const ThreadSafeQueue1&) = delete;
 	ThreadSafeQueue1& operator=(const ThreadSafeQueue1&) = delete;
 	ThreadSafeQueue1(ThreadSafeQueue1&&) = delete;
 	ThreadSafeQueue1& operator=(ThreadSafeQueue1&&) = delete;
 
+	allocator_type get_allocator() const;
 	bool empty() const;
 	size_t size() const;
 	void push(const Element &element);
 	void push(Element &&element);
 	template<typename ...Ts>
 	void emplace(Ts &&... pars);
+	template<typename InputIt>
+	void pushBulk(InputIt first, InputIt last);
+
 	ElementPtr waitPop();
+	template<typename Rep, typename Period>
+	ElementPtr waitPopFor(const std::chrono::duration<Rep, Period> &timeout);
+	template<typename Clock, typename Duration>
+	ElementPtr waitPopUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline);
 	ElementPtr tryPop();
+
+	Element waitPopValue();
+	template<typename Rep, typename Period>
+	std::optional<Element> waitPopValueFor(
+			const std::chrono::duration<Rep, Period> &timeout);
+	template<typename Clock, typename Duration>
+	std::optional<Element> waitPopValueUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline);
+	std::optional<Element> tryPopValue();
+	template<typename OutputIt>
+	size_t popBulk(OutputIt out, size_t max_count);
 private:
-	mutable std::mutex m_mutex;
-	std::condition_variable m_cond;
-	std::queue<ElementPtr, Container> m_queue;
+	Element takeFront();
+	void notify(size_t count);
+
+	mutable Lock m_mutex;
+	ConditionVariableFor<Lock> m_cond;
+	size_t m_nwaiters; // threads inside waitPop/waitPopUntil, guarded by m_mutex
+	Container m_queue;
 };
 
-template<typename Element>
-ThreadSafeQueue1<Element>::ThreadSafeQueue1() {
+template<typename Element, typename Allocator, typename Lock>
+ThreadSafeQueue1<Element, Allocator, Lock>::ThreadSafeQueue1() :
+		ThreadSafeQueue1(Allocator()) {
 }
 
-template<typename Element>
-ThreadSafeQueue1<Element>::~ThreadSafeQueue1() {
+template<typename Element, typename Allocator, typename Lock>
+ThreadSafeQueue1<Element, Allocator, Lock>::ThreadSafeQueue1(
+		const Allocator &allocator) :
+		m_nwaiters(0), m_queue(allocator) {
 }
 
-template<typename Element>
-bool ThreadSafeQueue1<Element>::empty() const {
-	std::lock_guard<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename Lock>
+ThreadSafeQueue1<Element, Allocator, Lock>::~ThreadSafeQueue1() {
+}
+
+template<typename Element, typename Allocator, typename Lock>
+typename ThreadSafeQueue1<Element, Allocator, Lock>::allocator_type ThreadSafeQueue1<
+		Element, Allocator, Lock>::get_allocator() const {
+	return m_queue.get_allocator();
+}
+
+template<typename Element, typename Allocator, typename Lock>
+bool ThreadSafeQueue1<Element, Allocator, Lock>::empty() const {
+	std::lock_guard<Lock> lock(m_mutex);
 	return m_queue.empty();
 }
 
-template<typename Element>
-size_t ThreadSafeQueue1<Element>::size() const {
-	std::lock_guard<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename Lock>
+size_t ThreadSafeQueue1<Element, Allocator, Lock>::size() const {
+	std::lock_guard<Lock> lock(m_mutex);
 	return m_queue.size();
 }
 
-template<typename Element>
-void ThreadSafeQueue1<Element>::push(const Element &element) {
-	ElementPtr new_element(std::make_unique<Element>(element));
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(std::move(new_element));
-	}
-	m_cond.notify_one();
+template<typename Element, typename Allocator, typename Lock>
+void ThreadSafeQueue1<Element, Allocator, Lock>::push(const Element &element) {
+	emplace(element);
 }
 
-template<typename Element>
-void ThreadSafeQueue1<Element>::push(Element &&element) {
-	ElementPtr new_element(std::make_unique<Element>(std::move(element)));
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(std::move(new_element));
-	}
-	m_cond.notify_one();
+template<typename Element, typename Allocator, typename Lock>
+void ThreadSafeQueue1<Element, Allocator, Lock>::push(Element &&element) {
+	emplace(std::move(element));
 }
 
-template<typename Element>
+// The element is constructed in place under the lock, a waiting thread
+// is only notified if there is one (no futex call while all consumers poll)
+template<typename Element, typename Allocator, typename Lock>
 template<typename ...Ts>
-void ThreadSafeQueue1<Element>::emplace(Ts &&... pars) {
-	ElementPtr new_element(
-			std::make_unique<Element>(std::forward<Ts>(pars)...));
+void ThreadSafeQueue1<Element, Allocator, Lock>::emplace(Ts &&... pars) {
+	size_t count;
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(std::move(new_element));
+		std::lock_guard<Lock> lock(m_mutex);
+		m_queue.emplaceBack(std::forward<Ts>(pars)...);
+		count = std::min<size_t>(1, m_nwaiters);
+	}
+	notify(count);
+}
+
+template<typename Element, typename Allocator, typename Lock>
+template<typename InputIt>
+void ThreadSafeQueue1<Element, Allocator, Lock>::pushBulk(InputIt first,
+		InputIt last) {
+	// take the lock and notify once for the whole batch (or for the elements
+	// pushed before a constructor threw)
+	size_t count = 0;
+	std::unique_lock<Lock> lock(m_mutex);
+	try {
+		for (; first != last; ++first, ++count)
+			m_queue.emplaceBack(*first);
+	} catch (...) {
+		count = std::min(count, m_nwaiters);
+		lock.unlock();
+		notify(count);
+		throw;
 	}
-	m_cond.notify_one();
+	count = std::min(count, m_nwaiters);
+	lock.unlock();
+	notify(count);
+}
+
+// Moves the front element out of the queue, the caller holds m_mutex
+template<typename Element, typename Allocator, typename Lock>
+Element ThreadSafeQueue1<Element, Allocator, Lock>::takeFront() {
+	Element front_element(std::move(m_queue.front()));
+	m_queue.popFront();
+	return front_element;
+}
+
+template<typename Element, typename Allocator, typename Lock>
+typename ThreadSafeQueue1<Element, Allocator, Lock>::ElementPtr ThreadSafeQueue1<
+		Element, Allocator, Lock>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
 }
 
-template<typename Element>
-typename ThreadSafeQueue1<Element>::ElementPtr ThreadSafeQueue1<Element>::waitPop() {
-	std::unique_lock<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename Lock>
+template<typename Rep, typename Period>
+typename ThreadSafeQueue1<Element, Allocator, Lock>::ElementPtr ThreadSafeQueue1<
+		Element, Allocator, Lock>::waitPopFor(
+		const std::chrono::duration<Rep, Period> &timeout) {
+	return waitPopUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+// Returns a null pointer if the queue is still empty at the deadline
+template<typename Element, typename Allocator, typename Lock>
+template<typename Clock, typename Duration>
+typename ThreadSafeQueue1<Element, Allocator, Lock>::ElementPtr ThreadSafeQueue1<
+		Element, Allocator, Lock>::waitPopUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline) {
+	std::optional<Element> front_element(waitPopValueUntil(deadline));
+	if (!front_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*front_element));
+}
+
+template<typename Element, typename Allocator, typename Lock>
+typename ThreadSafeQueue1<Element, Allocator, Lock>::ElementPtr ThreadSafeQueue1<
+		Element, Allocator, Lock>::tryPop() {
+	std::optional<Element> front_element(tryPopValue());
+	if (!front_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*front_element));
+}
+
+template<typename Element, typename Allocator, typename Lock>
+Element ThreadSafeQueue1<Element, Allocator, Lock>::waitPopValue() {
+	std::unique_lock<Lock> lock(m_mutex);
+	++m_nwaiters;
 	m_cond.wait(lock, [this]() -> bool {
-		return !m_queue.empty();
+		return !this->m_queue.empty();
 	});
-	ElementPtr front_element(std::move(m_queue.front()));
-	m_queue.pop();
-	return front_element;
+	--m_nwaiters;
+	return takeFront();
+}
+
+template<typename Element, typename Allocator, typename Lock>
+template<typename Rep, typename Period>
+std::optional<Element> ThreadSafeQueue1<Element, Allocator, Lock>::waitPopValueFor(
+		const std::chrono::duration<Rep, Period> &timeout) {
+	return waitPopValueUntil(std::chrono::steady_clock::now() + timeout);
 }
 
-template<typename Element>
-typename ThreadSafeQueue1<Element>::ElementPtr ThreadSafeQueue1<Element>::tryPop() {
-	std::lock_guard<std::mutex> lock(m_mutex);
+// Returns an empty optional if the queue is still empty at the deadline
+template<typename Element, typename Allocator, typename Lock>
+template<typename Clock, typename Duration>
+std::optional<Element> ThreadSafeQueue1<Element, Allocator, Lock>::waitPopValueUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline) {
+	std::unique_lock<Lock> lock(m_mutex);
+	++m_nwaiters;
+	const bool ready = m_cond.wait_until(lock, deadline, [this]() -> bool {
+		return !this->m_queue.empty();
+	});
+	--m_nwaiters;
+	if (!ready)
+		return std::nullopt;
+	return takeFront();
+}
+
+template<typename Element, typename Allocator, typename Lock>
+std::optional<Element> ThreadSafeQueue1<Element, Allocator, Lock>::tryPopValue() {
+	std::lock_guard<Lock> lock(m_mutex);
 	if (m_queue.empty())
-		return ElementPtr(nullptr);
-	ElementPtr front_element(std::move(m_queue.front()));
-	m_queue.pop();
-	return front_element;
+		return std::nullopt;
+	return takeFront();
+}
+
+template<typename Element, typename Allocator, typename Lock>
+template<typename OutputIt>
+size_t ThreadSafeQueue1<Element, Allocator, Lock>::popBulk(OutputIt out,
+		size_t max_count) {
+	std::lock_guard<Lock> lock(m_mutex);
+	size_t count = 0;
+	for (; count < max_count && !m_queue.empty(); ++count) {
+		*out = std::move(m_queue.front());
+		++out;
+		m_queue.popFront();
+	}
+	return count;
+}
+
+// Wakes up count waiting threads with a single notification
+template<typename Element, typename Allocator, typename Lock>
+void ThreadSafeQueue1<Element, Allocator, Lock>::notify(size_t count) {
+	if (count == 1)
+		m_cond.notify_one();
+	else if (count > 1)
+		m_cond.notify_all();
 }
 
 #endif /* THREADSAFE_QUEUE1_H_ */
@@ -0,0 +1,240 @@
+/*
+ * threadsafe_queue5.h
+ *
+ * Lock-free thread-safe bounded queue implemented using a power-of-two ring buffer,
+ * per-slot sequence numbers (Vyukov-style), and atomic operations with
+ * the acquire-release memory models
+ *
+ * The ring buffer is allocated and the elements are constructed with Allocator
+ * (e.g. std::pmr::polymorphic_allocator, which also hands its memory resource
+ * to elements that use one).
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE5_H_
+#define THREADSAFE_QUEUE5_H_
+
+#include <memory> // std::allocator, std::allocator_traits, std::make_obj_using_allocator
+#include <utility> // std::move
+#include <atomic> // std::atomic
+#include <optional> // std::optional
+#include <new> // placement new
+#include <type_traits> // std::aligned_storage, std::is_nothrow_move_constructible
+#include <thread> // std::this_thread::yield
+#include <cstddef> // std::size_t, std::ptrdiff_t
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeQueue5 {
+	static_assert(std::is_nothrow_move_constructible<Element>::value,
+			"Element must be nothrow move constructible");
+
+	static constexpr size_t kCacheLineSize = 64;
+
+	struct Slot {
+		std::atomic<size_t> m_sequence;
+		typename std::aligned_storage<sizeof(Element), alignof(Element)>::type m_storage;
+		Element* data() {
+			return reinterpret_cast<Element*>(&m_storage);
+		}
+	};
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Slot> SlotAllocator;
+	typedef std::allocator_traits<SlotAllocator> SlotAllocatorTraits;
+public:
+	typedef Allocator allocator_type;
+
+	explicit ThreadSafeQueue5(size_t capacity, const Allocator &allocator =
+			Allocator());
+	~ThreadSafeQueue5();
+	ThreadSafeQueue5(const ThreadSafeQueue5&) = delete;
+	ThreadSafeQueue5& operator=(const ThreadSafeQueue5&) = delete;
+	ThreadSafeQueue5(ThreadSafeQueue5&&) = delete;
+	ThreadSafeQueue5& operator=(ThreadSafeQueue5&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t capacity() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	bool tryPush(const Element &element);
+	bool tryPush(Element &&element);
+	template<typename ...Ts>
+	bool tryEmplace(Ts &&... pars);
+	std::optional<Element> tryPop();
+private:
+	static size_t roundUpCapacity(size_t capacity);
+	static Slot* allocateSlots(const ElementAllocator &allocator, size_t count);
+	template<typename ...Ts>
+	Element makeElement(Ts &&... pars) const;
+
+	const ElementAllocator m_allocator;
+	const size_t m_mask;
+	Slot *const m_slots;
+	alignas(kCacheLineSize) std::atomic<size_t> m_label_back;
+	alignas(kCacheLineSize) std::atomic<size_t> m_label_front;
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue5<Element, Allocator>::ThreadSafeQueue5(size_t capacity,
+		const Allocator &allocator) :
+		m_allocator(allocator), m_mask(roundUpCapacity(capacity) - 1), m_slots(
+				allocateSlots(m_allocator, m_mask + 1)), m_label_back(0), m_label_front(
+				0) {
+	for (size_t ind = 0; ind <= m_mask; ++ind)
+		m_slots[ind].m_sequence.store(ind, std::memory_order_relaxed);
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue5<Element, Allocator>::~ThreadSafeQueue5() {
+	const size_t back = m_label_back.load(std::memory_order_relaxed);
+	for (size_t pos = m_label_front.load(std::memory_order_relaxed);
+			pos != back; ++pos) {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::destroy(allocator, m_slots[pos & m_mask].data());
+	}
+	SlotAllocator slot_allocator(m_allocator);
+	SlotAllocatorTraits::deallocate(slot_allocator, m_slots, m_mask + 1);
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue5<Element, Allocator>::allocator_type ThreadSafeQueue5<
+		Element, Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeQueue5<Element, Allocator>::roundUpCapacity(size_t capacity) {
+	size_t rounded = 2;
+	while (rounded < capacity)
+		rounded <<= 1;
+	return rounded;
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue5<Element, Allocator>::Slot* ThreadSafeQueue5<Element,
+		Allocator>::allocateSlots(const ElementAllocator &allocator,
+		size_t count) {
+	SlotAllocator slot_allocator(allocator);
+	Slot *slots = SlotAllocatorTraits::allocate(slot_allocator, count);
+	for (size_t ind = 0; ind < count; ++ind)
+		new (&slots[ind]) Slot();
+	return slots;
+}
+
+// Constructs the element to be moved into a slot with the queue's allocator, so that
+// the move does not have to copy it into a different memory resource
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+Element ThreadSafeQueue5<Element, Allocator>::makeElement(Ts &&... pars) const {
+	return std::make_obj_using_allocator<Element>(m_allocator,
+			std::forward<Ts>(pars)...);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue5<Element, Allocator>::empty() const {
+	const size_t front = m_label_front.load(std::memory_order_acquire);
+	return m_slots[front & m_mask].m_sequence.load(std::memory_order_acquire)
+			!= front + 1;
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeQueue5<Element, Allocator>::capacity() const {
+	return m_mask + 1;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue5<Element, Allocator>::push(const Element &element) {
+	Element new_element(makeElement(element));
+	while (!tryPush(std::move(new_element)))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue5<Element, Allocator>::push(Element &&element) {
+	while (!tryPush(std::move(element)))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeQueue5<Element, Allocator>::emplace(Ts &&... pars) {
+	Element new_element(makeElement(std::forward<Ts>(pars)...));
+	while (!tryPush(std::move(new_element)))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue5<Element, Allocator>::tryPush(const Element &element) {
+	Element new_element(makeElement(element));
+	return tryPush(std::move(new_element));
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue5<Element, Allocator>::tryPush(Element &&element) {
+	size_t pos = m_label_back.load(std::memory_order_relaxed);
+	Slot *slot;
+	for (;;) {
+		slot = &m_slots[pos & m_mask];
+		const size_t seq = slot->m_sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq)
+				- static_cast<std::ptrdiff_t>(pos);
+		if (diff == 0) {
+			// slot is free for this lap, claim it
+			if (m_label_back.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// slot still holds the element from the previous lap
+			return false;
+		} else {
+			pos = m_label_back.load(std::memory_order_relaxed);
+		}
+	}
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::construct(allocator, slot->data(),
+			std::move(element));
+	slot->m_sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+bool ThreadSafeQueue5<Element, Allocator>::tryEmplace(Ts &&... pars) {
+	Element new_element(makeElement(std::forward<Ts>(pars)...));
+	return tryPush(std::move(new_element));
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeQueue5<Element, Allocator>::tryPop() {
+	size_t pos = m_label_front.load(std::memory_order_relaxed);
+	Slot *slot;
+	for (;;) {
+		slot = &m_slots[pos & m_mask];
+		const size_t seq = slot->m_sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq)
+				- static_cast<std::ptrdiff_t>(pos + 1);
+		if (diff == 0) {
+			// slot has been published for this lap, claim it
+			if (m_label_front.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// slot has not been published yet
+			return std::nullopt;
+		} else {
+			pos = m_label_front.load(std::memory_order_relaxed);
+		}
+	}
+	std::optional<Element> front_element(std::move(*slot->data()));
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::destroy(allocator, slot->data());
+	slot->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+	return front_element;
+}
+
+#endif /* THREADSAFE_QUEUE5_H_ */
@@ -0,0 +1,197 @@
+/*
+ * threadsafe_queue6.h
+ *
+ * Wait-free thread-safe bounded single-producer/single-consumer queue implemented
+ * using a power-of-two ring buffer, locally cached head/tail indices, and
+ * atomic operations with the acquire-release memory models
+ *
+ * The ring buffer is allocated and the elements are constructed with Allocator.
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE6_H_
+#define THREADSAFE_QUEUE6_H_
+
+#include <memory> // std::allocator, std::allocator_traits
+#include <utility> // std::move
+#include <atomic> // std::atomic
+#include <optional> // std::optional
+#include <new> // placement new
+#include <type_traits> // std::aligned_storage
+#include <thread> // std::this_thread::yield
+#include <cstddef> // std::size_t
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeQueue6 {
+	static constexpr size_t kCacheLineSize = 64;
+
+	typedef typename std::aligned_storage<sizeof(Element), alignof(Element)>::type Slot;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Slot> SlotAllocator;
+	typedef std::allocator_traits<SlotAllocator> SlotAllocatorTraits;
+public:
+	typedef Allocator allocator_type;
+
+	explicit ThreadSafeQueue6(size_t capacity, const Allocator &allocator =
+			Allocator());
+	~ThreadSafeQueue6();
+	ThreadSafeQueue6(const ThreadSafeQueue6&) = delete;
+	ThreadSafeQueue6& operator=(const ThreadSafeQueue6&) = delete;
+	ThreadSafeQueue6(ThreadSafeQueue6&&) = delete;
+	ThreadSafeQueue6& operator=(ThreadSafeQueue6&&) = delete;
+
+	// may be called by either side
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t capacity() const;
+	// producer side only
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	bool tryPush(const Element &element);
+	bool tryPush(Element &&element);
+	template<typename ...Ts>
+	bool tryEmplace(Ts &&... pars);
+	// consumer side only
+	std::optional<Element> tryPop();
+private:
+	static size_t roundUpCapacity(size_t capacity);
+	static Slot* allocateSlots(const ElementAllocator &allocator, size_t count);
+	Element* data(size_t pos) const;
+
+	const ElementAllocator m_allocator;
+	const size_t m_mask;
+	Slot *const m_slots;
+	// producer cache line: own index plus the last seen consumer index
+	alignas(kCacheLineSize) std::atomic<size_t> m_label_back;
+	size_t m_cached_front;
+	// consumer cache line: own index plus the last seen producer index
+	alignas(kCacheLineSize) std::atomic<size_t> m_label_front;
+	size_t m_cached_back;
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue6<Element, Allocator>::ThreadSafeQueue6(size_t capacity,
+		const Allocator &allocator) :
+		m_allocator(allocator), m_mask(roundUpCapacity(capacity) - 1), m_slots(
+				allocateSlots(m_allocator, m_mask + 1)), m_label_back(0), m_cached_front(
+				0), m_label_front(0), m_cached_back(0) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue6<Element, Allocator>::~ThreadSafeQueue6() {
+	const size_t back = m_label_back.load(std::memory_order_relaxed);
+	for (size_t pos = m_label_front.load(std::memory_order_relaxed);
+			pos != back; ++pos) {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::destroy(allocator, data(pos));
+	}
+	SlotAllocator slot_allocator(m_allocator);
+	SlotAllocatorTraits::deallocate(slot_allocator, m_slots, m_mask + 1);
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeQueue6<Element, Allocator>::roundUpCapacity(size_t capacity) {
+	size_t rounded = 2;
+	while (rounded < capacity)
+		rounded <<= 1;
+	return rounded;
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue6<Element, Allocator>::Slot* ThreadSafeQueue6<Element,
+		Allocator>::allocateSlots(const ElementAllocator &allocator,
+		size_t count) {
+	SlotAllocator slot_allocator(allocator);
+	return SlotAllocatorTraits::allocate(slot_allocator, count);
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue6<Element, Allocator>::allocator_type ThreadSafeQueue6<
+		Element, Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+Element* ThreadSafeQueue6<Element, Allocator>::data(size_t pos) const {
+	return reinterpret_cast<Element*>(&m_slots[pos & m_mask]);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue6<Element, Allocator>::empty() const {
+	return m_label_front.load(std::memory_order_acquire)
+			== m_label_back.load(std::memory_order_acquire);
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeQueue6<Element, Allocator>::capacity() const {
+	return m_mask + 1;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue6<Element, Allocator>::push(const Element &element) {
+	while (!tryPush(element))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue6<Element, Allocator>::push(Element &&element) {
+	while (!tryPush(std::move(element)))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeQueue6<Element, Allocator>::emplace(Ts &&... pars) {
+	while (!tryEmplace(std::forward<Ts>(pars)...))
+		std::this_thread::yield();
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue6<Element, Allocator>::tryPush(const Element &element) {
+	return tryEmplace(element);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue6<Element, Allocator>::tryPush(Element &&element) {
+	return tryEmplace(std::move(element));
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+bool ThreadSafeQueue6<Element, Allocator>::tryEmplace(Ts &&... pars) {
+	const size_t back = m_label_back.load(std::memory_order_relaxed);
+	if (back - m_cached_front > m_mask) {
+		// cached consumer index says full, refresh it from the shared cache line
+		m_cached_front = m_label_front.load(std::memory_order_acquire);
+		if (back - m_cached_front > m_mask)
+			return false;
+	}
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::construct(allocator, data(back),
+			std::forward<Ts>(pars)...);
+	m_label_back.store(back + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeQueue6<Element, Allocator>::tryPop() {
+	const size_t front = m_label_front.load(std::memory_order_relaxed);
+	if (front == m_cached_back) {
+		// cached producer index says empty, refresh it from the shared cache line
+		m_cached_back = m_label_back.load(std::memory_order_acquire);
+		if (front == m_cached_back)
+			return std::nullopt;
+	}
+	std::optional<Element> front_element(std::move(*data(front)));
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::destroy(allocator, data(front));
+	m_label_front.store(front + 1, std::memory_order_release);
+	return front_element;
+}
+
+#endif /* THREADSAFE_QUEUE6_H_ */
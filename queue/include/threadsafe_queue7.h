@@ -0,0 +1,154 @@
+/*
+ * threadsafe_queue7.h
+ *
+ * Flat-combining thread-safe unbounded queue implemented using a chunked ring buffer
+ * and a flat combiner (blocking pops spin, then park on an event count)
+ *
+ * Every operation is handed to FlatCombiner (flat_combining.h), which runs the pending
+ * operations of all threads in batches on the ChunkedRing (chunked_ring.h) of queue #1,
+ * so the ring stays in the cache of the combining thread.
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE7_H_
+#define THREADSAFE_QUEUE7_H_
+
+#include <memory> // std::unique_ptr, std::allocator
+#include <utility> // std::move
+#include <optional> // std::optional
+#include <exception> // std::exception
+#include "chunked_ring.h" // ChunkedRing
+#include "flat_combining.h" // FlatCombiner
+#include "event_count.h" // EventCount
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeQueue7 {
+	typedef std::unique_ptr<Element> ElementPtr;
+	typedef ChunkedRing<Element, Allocator> Container;
+
+	struct EmptyQueue: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty Queue";
+		}
+	};
+public:
+	typedef Allocator allocator_type;
+
+	ThreadSafeQueue7();
+	explicit ThreadSafeQueue7(const Allocator &allocator);
+	~ThreadSafeQueue7();
+	ThreadSafeQueue7(const ThreadSafeQueue7&) = delete;
+	ThreadSafeQueue7& operator=(const ThreadSafeQueue7&) = delete;
+	ThreadSafeQueue7(ThreadSafeQueue7&&) = delete;
+	ThreadSafeQueue7& operator=(ThreadSafeQueue7&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t size() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	ElementPtr waitPop();
+	ElementPtr tryPop();
+	Element waitPopValue();
+	std::optional<Element> tryPopValue();
+private:
+	mutable FlatCombiner m_combiner;
+	EventCount m_event_count;
+	Container m_queue;
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue7<Element, Allocator>::ThreadSafeQueue7() :
+		ThreadSafeQueue7(Allocator()) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue7<Element, Allocator>::ThreadSafeQueue7(
+		const Allocator &allocator) :
+		m_queue(allocator) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeQueue7<Element, Allocator>::~ThreadSafeQueue7() {
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue7<Element, Allocator>::allocator_type ThreadSafeQueue7<
+		Element, Allocator>::get_allocator() const {
+	return m_queue.get_allocator();
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeQueue7<Element, Allocator>::empty() const {
+	bool is_empty;
+	m_combiner.execute([&]() {
+		is_empty = m_queue.empty();
+	});
+	return is_empty;
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeQueue7<Element, Allocator>::size() const {
+	size_t count;
+	m_combiner.execute([&]() {
+		count = m_queue.size();
+	});
+	return count;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue7<Element, Allocator>::push(const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeQueue7<Element, Allocator>::push(Element &&element) {
+	emplace(std::move(element));
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeQueue7<Element, Allocator>::emplace(Ts &&... pars) {
+	m_combiner.execute([&]() {
+		m_queue.emplaceBack(std::forward<Ts>(pars)...);
+	});
+	m_event_count.notifyOne();
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue7<Element, Allocator>::ElementPtr ThreadSafeQueue7<
+		Element, Allocator>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeQueue7<Element, Allocator>::ElementPtr ThreadSafeQueue7<
+		Element, Allocator>::tryPop() {
+	std::optional<Element> front_element(tryPopValue());
+	if (!front_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*front_element));
+}
+
+template<typename Element, typename Allocator>
+Element ThreadSafeQueue7<Element, Allocator>::waitPopValue() {
+	return std::move(*m_event_count.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeQueue7<Element, Allocator>::tryPopValue() {
+	std::optional<Element> front_element;
+	m_combiner.execute([&]() {
+		if (m_queue.empty())
+			return;
+		front_element.emplace(std::move(m_queue.front()));
+		m_queue.popFront();
+	});
+	return front_element;
+}
+
+#endif /* THREADSAFE_QUEUE7_H_ */
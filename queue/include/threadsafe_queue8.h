@@ -0,0 +1,115 @@
+/*
+ * threadsafe_queue8.h
+ *
+ * Intrusive thread-safe unbounded multi-producer/single-consumer queue implemented
+ * using a singly-linked list of the messages themselves (Vyukov-style, with a stub
+ * node), and atomic operations with the acquire-release memory models
+ *
+ * A message derives from MpscHook, so the queue neither allocates nor copies: push
+ * links the message the caller owns and tryPop hands the same message back. A message
+ * must stay alive and must not be pushed again until the consumer has popped it.
+ *
+ * A producer pushes with a single exchange on the back label and a release store of
+ * the link, it never retries. The consumer pops with plain loads and stores; the only
+ * RMW on its side is the exchange that re-inserts the stub when it takes the last
+ * message. Until a producer has stored its link the list is cut behind the previous
+ * message, tryPop then returns nullptr although later pushes may have returned.
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE8_H_
+#define THREADSAFE_QUEUE8_H_
+
+#include <atomic> // std::atomic
+#include <type_traits> // std::is_base_of_v
+#include <cstddef> // std::size_t
+
+struct MpscHook {
+	std::atomic<MpscHook*> next { nullptr };
+};
+
+template<typename Message>
+class ThreadSafeQueue8 {
+	static_assert(std::is_base_of_v<MpscHook, Message>,
+			"The message of the intrusive queue has to derive from MpscHook");
+	static constexpr size_t kCacheLineSize = 64;
+public:
+	ThreadSafeQueue8();
+	~ThreadSafeQueue8();
+	ThreadSafeQueue8(const ThreadSafeQueue8&) = delete;
+	ThreadSafeQueue8& operator=(const ThreadSafeQueue8&) = delete;
+	ThreadSafeQueue8(ThreadSafeQueue8&&) = delete;
+	ThreadSafeQueue8& operator=(ThreadSafeQueue8&&) = delete;
+
+	// any thread
+	void push(Message &message);
+	// consumer side only
+	bool empty() const;
+	Message* tryPop();
+private:
+	void pushHook(MpscHook *hook);
+
+	// producer cache line
+	alignas(kCacheLineSize) std::atomic<MpscHook*> m_label_back;
+	// consumer cache line: the front of the list and the stub that keeps it non-empty
+	alignas(kCacheLineSize) MpscHook *m_label_front;
+	MpscHook m_stub;
+};
+
+template<typename Message>
+ThreadSafeQueue8<Message>::ThreadSafeQueue8() :
+		m_label_back(&m_stub), m_label_front(&m_stub) {
+}
+
+template<typename Message>
+ThreadSafeQueue8<Message>::~ThreadSafeQueue8() {
+	// the messages still queued belong to the caller, nothing to release
+}
+
+template<typename Message>
+void ThreadSafeQueue8<Message>::push(Message &message) {
+	pushHook(&message);
+}
+
+template<typename Message>
+void ThreadSafeQueue8<Message>::pushHook(MpscHook *hook) {
+	hook->next.store(nullptr, std::memory_order_relaxed);
+	MpscHook *prev = m_label_back.exchange(hook, std::memory_order_acq_rel);
+	// publishes the message (and everything written to it before the push)
+	prev->next.store(hook, std::memory_order_release);
+}
+
+template<typename Message>
+bool ThreadSafeQueue8<Message>::empty() const {
+	return m_label_front == &m_stub
+			&& !m_stub.next.load(std::memory_order_acquire);
+}
+
+template<typename Message>
+Message* ThreadSafeQueue8<Message>::tryPop() {
+	MpscHook *front = m_label_front;
+	MpscHook *next = front->next.load(std::memory_order_acquire);
+	if (front == &m_stub) {
+		// skip the stub
+		if (!next)
+			return nullptr;
+		m_label_front = front = next;
+		next = front->next.load(std::memory_order_acquire);
+	}
+	if (next) {
+		m_label_front = next;
+		return static_cast<Message*>(front);
+	}
+	// front is the last linked message: it can only be taken once the stub is queued
+	// behind it, unless a producer has already swapped the back label past it
+	if (front != m_label_back.load(std::memory_order_acquire))
+		return nullptr;
+	pushHook(&m_stub);
+	next = front->next.load(std::memory_order_acquire);
+	if (!next)
+		return nullptr;
+	m_label_front = next;
+	return static_cast<Message*>(front);
+}
+
+#endif /* THREADSAFE_QUEUE8_H_ */
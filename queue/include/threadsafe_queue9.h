@@ -0,0 +1,76 @@
+/*
+ * threadsafe_queue9.h
+ *
+ * Intrusive thread-safe unbounded queue implemented using the multi-producer/
+ * single-consumer list of queue #8, a consumer lock, and an event count (blocking
+ * pops spin, then park)
+ *
+ * Producers push lock-free with the single exchange of queue #8, consumers take
+ * turns on the consumer side under Lock (any lock of lock_policy.h). A message
+ * derives from MpscHook and is linked in place, so push and pop neither allocate
+ * nor copy, and pop hands back the very object that was pushed.
+ *
+ */
+
+#ifndef THREADSAFE_QUEUE9_H_
+#define THREADSAFE_QUEUE9_H_
+
+#include <mutex> // std::mutex, std::lock_guard
+#include "threadsafe_queue8.h" // ThreadSafeQueue8, MpscHook
+#include "lock_policy.h" // McsLock, TicketLock, SpinThenParkLock
+#include "event_count.h" // EventCount
+
+template<typename Message, typename Lock = std::mutex>
+class ThreadSafeQueue9 {
+public:
+	ThreadSafeQueue9();
+	~ThreadSafeQueue9();
+	ThreadSafeQueue9(const ThreadSafeQueue9&) = delete;
+	ThreadSafeQueue9& operator=(const ThreadSafeQueue9&) = delete;
+	ThreadSafeQueue9(ThreadSafeQueue9&&) = delete;
+	ThreadSafeQueue9& operator=(ThreadSafeQueue9&&) = delete;
+
+	bool empty() const;
+	void push(Message &message);
+	Message* waitPop();
+	Message* tryPop();
+private:
+	mutable Lock m_consumer_lock;
+	EventCount m_event_count;
+	ThreadSafeQueue8<Message> m_queue;
+};
+
+template<typename Message, typename Lock>
+ThreadSafeQueue9<Message, Lock>::ThreadSafeQueue9() {
+}
+
+template<typename Message, typename Lock>
+ThreadSafeQueue9<Message, Lock>::~ThreadSafeQueue9() {
+}
+
+template<typename Message, typename Lock>
+bool ThreadSafeQueue9<Message, Lock>::empty() const {
+	std::lock_guard<Lock> lock(m_consumer_lock);
+	return m_queue.empty();
+}
+
+template<typename Message, typename Lock>
+void ThreadSafeQueue9<Message, Lock>::push(Message &message) {
+	m_queue.push(message);
+	m_event_count.notifyOne();
+}
+
+template<typename Message, typename Lock>
+Message* ThreadSafeQueue9<Message, Lock>::waitPop() {
+	return m_event_count.await([this]() {
+		return this->tryPop();
+	});
+}
+
+template<typename Message, typename Lock>
+Message* ThreadSafeQueue9<Message, Lock>::tryPop() {
+	std::lock_guard<Lock> lock(m_consumer_lock);
+	return m_queue.tryPop();
+}
+
+#endif /* THREADSAFE_QUEUE9_H_ */
@@ -1,5 +1,5 @@
 //============================================================================
-// Script for testing the performance of four implementations of thread-safe queue
+// Script for testing the performance of nine implementations of thread-safe queue
 //============================================================================
 
 #include <iostream>
@@ -12,21 +12,63 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <functional>
 #include <numeric>
 #include <cmath>
+#include <atomic>
+#include <new>
+#include <memory_resource>
+#include <cstdlib>
 #include "timer.h"
+#include "threadsafe_queue.h"
 #include "threadsafe_queue1.h"
 #include "threadsafe_queue2.h"
 #include "threadsafe_queue3.h"
 #include "threadsafe_queue4.h"
+#include "threadsafe_queue5.h"
+#include "threadsafe_queue6.h"
+#include "threadsafe_queue7.h"
+#include "threadsafe_queue8.h"
+#include "threadsafe_queue9.h"
 using namespace std;
 
+// Heap allocation counters: every thread counts its own calls to operator new,
+// the PUSH and POP threads add their count to the total of the test run when done
+thread_local size_t tlNallocations = 0;
+atomic<size_t> gNallocations(0);
+
+void* operator new(size_t size) {
+	++tlNallocations;
+	if (void *ptr = malloc(size ? size : 1))
+		return ptr;
+	throw bad_alloc();
+}
+void* operator new(size_t size, align_val_t align) {
+	++tlNallocations;
+	const size_t kAlign = static_cast<size_t>(align);
+	if (void *ptr = aligned_alloc(kAlign, (size + kAlign - 1) / kAlign * kAlign))
+		return ptr;
+	throw bad_alloc();
+}
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+	free(ptr);
+}
+void operator delete(void *ptr, align_val_t) noexcept {
+	free(ptr);
+}
+void operator delete(void *ptr, size_t, align_val_t) noexcept {
+	free(ptr);
+}
+
 void usageMsg(void) {
 	string separator(50, '-');
 	ostringstream msg;
 	msg << separator << endl;
 	msg
-			<< "Usage: ./threadsafe_queue_test kNelements kNpushThreads kNpopThreads kTimeHeadStart kNiter"
+			<< "Usage: ./threadsafe_queue_test kNelements kNpushThreads kNpopThreads kTimeHeadStart kNiter [kBatchSize [kNwaitPopThreads [kSweep [kLock]]]]"
 			<< endl << endl;
 	msg << "Where: " << endl;
 	msg << "kNelements = number of elements to be PUSHed or POPed" << endl;
@@ -37,23 +79,156 @@ void usageMsg(void) {
 	msg << "kTimeHeadStart = head start in [ms] for data processing threads"
 			<< endl;
 	msg << "kNiter = number of test runs (iterations)" << endl;
+	msg
+			<< "kBatchSize = number of elements per bulk PUSH or POP (optional, default 1)"
+			<< endl;
+	msg
+			<< "kNwaitPopThreads = number of POP threads blocking in waitPop instead of polling with tryPop (optional, default 0)"
+			<< endl;
+	msg
+			<< "kSweep = 1 to also test every combination of the ThreadSafeQueue policies (optional, default 0)"
+			<< endl;
+	msg
+			<< "kLock = lock of the lock-based queues #1 and #2: mutex, mcs, ticket, spinpark or all (optional, default mutex)"
+			<< endl;
 	msg << separator << endl;
 	msg << "aborting.." << endl;
 	cerr << msg.str() << endl;
 	terminate();
 }
 
+// Test parameters
+struct TestParameters {
+	size_t kNelements; // number of elements to be PUSHed or POPed
+	size_t kNpushThreads; // number of data preparation threads (PUSH thread)
+	size_t kNpopThreads; // number of data processing threads (POP thread)
+	size_t kTimeHeadStart; // head start in [ms] for data processing threads
+	size_t kNiter; // number of test runs (iterations)
+	size_t kBatchSize; // number of elements per bulk PUSH or POP
+	size_t kNwaitPopThreads; // number of POP threads blocking in waitPop instead of polling with tryPop
+	bool kSweep; // test every combination of the ThreadSafeQueue policies
+	string kLock; // lock of the lock-based queues: mutex, mcs, ticket, spinpark or all
+};
+
 // Function to PUSH the number of elements (kNelements) onto the queue
 template<typename T>
-void pushValues(T &queue, const size_t kNelements) {
-	for (size_t ind = 0; ind < kNelements; ++ind)
+void pushValues(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
 		queue.push(ind);
+	gNallocations += tlNallocations - kNallocations;
+}
+// Function to POP one element off the queue, by value if the queue supports it
+template<typename T>
+auto popValue(T &queue, int) -> decltype(queue.tryPopValue()) {
+	return queue.tryPopValue();
+}
+template<typename T>
+auto popValue(T &queue, long) -> decltype(queue.tryPop()) {
+	return queue.tryPop();
 }
 // Function to POOP the number of elements (kNelements) off the queue
 template<typename T>
-void popValues(T &queue, const size_t kNelements) {
-	for (size_t ind = 0; ind < kNelements; ++ind)
-		queue.tryPop();
+void popValues(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
+		popValue(queue, 0);
+	gNallocations += tlNallocations - kNallocations;
+}
+// Function to POP one element off the queue, blocking while it is empty if the queue supports a timed wait.
+// The timeout ends the wait if the PUSH threads run out of elements for the POP threads.
+const auto kWaitPopTimeout = chrono::milliseconds(100);
+template<typename T>
+auto waitPopValue(T &queue, int) -> decltype(queue.waitPopValueFor(kWaitPopTimeout)) {
+	return queue.waitPopValueFor(kWaitPopTimeout);
+}
+template<typename T>
+auto waitPopValue(T &queue, long) -> decltype(queue.waitPopFor(kWaitPopTimeout)) {
+	return queue.waitPopFor(kWaitPopTimeout);
+}
+template<typename T>
+auto waitPopValue(T &queue, ...) -> decltype(popValue(queue, 0)) {
+	return popValue(queue, 0);
+}
+// Function to POOP the number of elements (kNelements) off the queue, blocking while it is empty
+template<typename T>
+void waitPopValues(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
+		waitPopValue(queue, 0);
+	gNallocations += tlNallocations - kNallocations;
+}
+// Function to PUSH the number of elements (kNelements) onto the queue in batches (kBatchSize)
+template<typename T>
+void pushValuesBulk(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	vector<int> batch;
+	batch.reserve(kPars.kBatchSize);
+	for (size_t ind = 0; ind < kPars.kNelements; ind += batch.size()) {
+		batch.clear();
+		for (size_t batchInd = 0;
+				batchInd < kPars.kBatchSize && ind + batchInd < kPars.kNelements;
+				++batchInd)
+			batch.push_back(ind + batchInd);
+		queue.pushBulk(batch.begin(), batch.end());
+	}
+	gNallocations += tlNallocations - kNallocations;
+}
+// Function to POOP the number of elements (kNelements) off the queue in batches (kBatchSize)
+template<typename T>
+void popValuesBulk(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	vector<int> batch;
+	batch.reserve(kPars.kBatchSize);
+	for (size_t ind = 0; ind < kPars.kNelements; ind += kPars.kBatchSize) {
+		batch.clear();
+		queue.popBulk(back_inserter(batch),
+				min(kPars.kBatchSize, kPars.kNelements - ind));
+	}
+	gNallocations += tlNallocations - kNallocations;
+}
+
+// Function to POP the elements of all PUSH threads off the queue (the single POP thread of a mailbox)
+template<typename T>
+void drainValues(T &queue, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	for (size_t ind = 0; ind < kPars.kNelements * kPars.kNpushThreads;)
+		if (popValue(queue, 0))
+			++ind;
+		else
+			this_thread::yield();
+	gNallocations += tlNallocations - kNallocations;
+}
+
+// Message of the intrusive queues #8 and #9, it embeds the link of the queue
+struct Message: public MpscHook {
+	size_t value;
+};
+// Mailbox holding the messages of all PUSH threads, so that a message outlives the thread that PUSHed it
+template<typename Queue>
+struct Mailbox {
+	explicit Mailbox(size_t nmessages) :
+			messages(nmessages) {
+	}
+	Message* tryPop() {
+		return queue.tryPop();
+	}
+
+	Queue queue;
+	vector<Message> messages;
+	atomic<size_t> next { 0 }; // first message of the next PUSH thread
+};
+// Function to PUSH the number of messages (kNelements) into the mailbox
+template<typename Queue>
+void pushMessages(Mailbox<Queue> &mailbox, const TestParameters &kPars) {
+	const size_t kNallocations = tlNallocations;
+	Message *messages = &mailbox.messages[mailbox.next.fetch_add(
+			kPars.kNelements)];
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind) {
+		messages[ind].value = ind;
+		mailbox.queue.push(messages[ind]);
+	}
+	gNallocations += tlNallocations - kNallocations;
 }
 
 // Function to calculate mean and std dev of test run timings
@@ -77,10 +252,15 @@ string calcMeanStd(const vector<size_t> &results) {
 	return os.str();
 }
 
-int main(int argc, char *argv[]) {
-
-	if (argc < 6)
-		usageMsg();
+// Function to run the test (kNiter runs) for a queue and report the result,
+// kPushValues and kPopValues are run by the PUSH and POP threads,
+// pars are forwarded to the constructor of the queue
+template<typename Queue,
+		void (*kPushValues)(Queue&, const TestParameters&) = pushValues<Queue>,
+		void (*kPopValues)(Queue&, const TestParameters&) = popValues<Queue>,
+		typename ...Ts>
+void testQueue(const string &kName, const TestParameters &kPars,
+		const Ts &... pars) {
 
 	// Timer
 	Timer timer;
@@ -90,203 +270,282 @@ int main(int argc, char *argv[]) {
 	const size_t kNsetwText = 25;
 	const size_t kNsetwNumber = 10;
 
-	// Test parameters
-	const size_t kNelements = stoi(string(argv[1])); // number of elements to be PUSHed or POPed
-	const size_t kNpushThreads = stoi(string(argv[2])); // number of data preparation threads (PUSH thread)
-	const size_t kNpopThreads = stoi(string(argv[3])); // number of data processing threads (POP thread)
-	const size_t kTimeHeadStart = stoi(string(argv[4])); // head start in [ms] for data processing threads
-	const size_t kNiter = stoi(string(argv[5])); // number of test runs (iterations)
 	vector<size_t> results; // container of results (timings of all test runs)
 	vector<std::thread> threads; // container of threads
-
-	cout << "Nelements: " << kNelements << endl;
-	cout << "NpushThreads: " << kNpushThreads << endl;
-	cout << "NpopThreads: " << kNpopThreads << endl;
-	cout << "TimeHeadStart [ms]: " << kTimeHeadStart << endl;
-	cout << "Niter: " << kNiter << endl;
-
-	{
-		// Test for queue #1
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeQueue1<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
-
-		// Report result
-		cout << separator << endl;
-		cout << "Test for queue #1 (avg of " << kNiter << " runs)" << endl;
-
-		cout << left << setw(kNsetwText) << "Size of empty queue: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeQueue1<int> )
-				<< " [bytes]" << endl;
-
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
+	gNallocations = 0;
+
+	for (size_t iterNo = 0; iterNo < kPars.kNiter; ++iterNo) {
+		Queue q(pars...);
+
+		timer.start();
+		// Spawn data preparation threads
+		for (size_t ind = 0; ind < kPars.kNpushThreads; ++ind)
+			threads.push_back(
+					std::thread(kPushValues, std::reference_wrapper<Queue>(q),
+							std::cref(kPars)));
+
+		// Head start for data preparation threads
+		this_thread::sleep_for(chrono::milliseconds(kPars.kTimeHeadStart));
+
+		// Spawn data processing threads, the first kNwaitPopThreads of them block in waitPop
+		for (size_t threadNo = 0; threadNo < kPars.kNpopThreads; ++threadNo)
+			threads.push_back(
+					std::thread(
+							threadNo < kPars.kNwaitPopThreads ?
+									waitPopValues<Queue> : kPopValues,
+							std::reference_wrapper<Queue>(q), std::cref(kPars)));
+
+		// Wait till we are done
+		std::for_each(threads.begin(), threads.end(),
+				std::mem_fn(&std::thread::join));
+
+		timer.stop();
+		threads.clear();
+		results.push_back(timer.duration() - kPars.kTimeHeadStart);
 	}
 
-	{
-		// Test for queue #2
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeQueue2<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
-
-		// Report result
-		cout << separator << endl;
-		cout << "Test for queue #2 (avg of " << kNiter << " runs)" << endl;
-
-		cout << left << setw(kNsetwText) << "Size of empty queue: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeQueue2<int> )
-				<< " [bytes]" << endl;
-
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
-	}
+	// Report result
+	cout << separator << endl;
+	cout << "Test for " << kName << " (avg of " << kPars.kNiter << " runs)"
+			<< endl;
+
+	cout << left << setw(kNsetwText) << "Size of empty queue: "
+			<< setw(kNsetwNumber) << sizeof(Queue) << " [bytes]" << endl;
+
+	cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
+			<< calcMeanStd(results) << " [ms]" << endl;
 
-	{
-		// Test for queue #3
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeQueue3<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
-
-		// Report result
-		cout << separator << endl;
-		cout << "Test for queue #3 (avg of " << kNiter << " runs)" << endl;
-
-		cout << left << setw(kNsetwText) << "Size of empty queue: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeQueue3<int> )
-				<< " [bytes]" << endl;
-
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
+	// PUSH and POP calls of all test runs
+	const double kNops = static_cast<double>(kPars.kNiter * kPars.kNelements
+			* (kPars.kNpushThreads + kPars.kNpopThreads));
+	cout << setw(kNsetwText) << "Allocations per op: " << setw(kNsetwNumber)
+			<< gNallocations / kNops << " [-]" << endl;
+	cout << separator << endl;
+}
+
+// Memory resource counting the bytes and blocks that are currently allocated from it
+class CountingResource: public pmr::memory_resource {
+public:
+	size_t bytes() const {
+		return m_bytes;
+	}
+	size_t blocks() const {
+		return m_blocks;
+	}
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override {
+		m_bytes += bytes;
+		++m_blocks;
+		return pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+		m_bytes -= bytes;
+		--m_blocks;
+		pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
 	}
+	bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+
+	atomic<size_t> m_bytes { 0 };
+	atomic<size_t> m_blocks { 0 };
+};
+
+// Function to report the memory held by a queue of kNqueued elements (bytes requested
+// from the allocator and allocated blocks per element, excluding the heap's own headers)
+template<typename Queue>
+void testMemory(const string &kName, size_t kNqueued) {
+
+	// Print format parameters
+	string separator(50, '-');
+	const size_t kNsetwText = 25;
+	const size_t kNsetwNumber = 10;
+
+	CountingResource resource;
+	Queue q { pmr::polymorphic_allocator<int>(&resource) };
+	for (size_t ind = 0; ind < kNqueued; ++ind)
+		q.push(ind);
+
+	cout << separator << endl;
+	cout << "Memory of " << kName << " (" << kNqueued << " queued elements)"
+			<< endl;
+	cout << left << setw(kNsetwText) << "Bytes per element: "
+			<< setw(kNsetwNumber)
+			<< static_cast<double>(resource.bytes()) / kNqueued << " [bytes]"
+			<< endl;
+	cout << setw(kNsetwText) << "Blocks per element: " << setw(kNsetwNumber)
+			<< static_cast<double>(resource.blocks()) / kNqueued << " [-]"
+			<< endl;
+	cout << separator << endl;
+}
+
+// Function to run the test for a combination of ThreadSafeQueue policies with every allocator
+template<typename SyncPolicy, typename ReclaimPolicy, typename WaitPolicy>
+void testAllocPolicies(const string &kName, const TestParameters &kPars) {
+	testQueue<
+			ThreadSafeQueue<int, SyncPolicy, ReclaimPolicy, std::allocator<int>,
+					WaitPolicy>>("queue (" + kName + ", std::allocator)", kPars);
+	testQueue<
+			ThreadSafeQueue<int, SyncPolicy, ReclaimPolicy, NodePoolAllocator<int>,
+					WaitPolicy>>("queue (" + kName + ", node pool)", kPars);
+}
 
-	{
-		// Test for queue #4
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeQueue4<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
-
-		// Report result
-		cout << separator << endl;
-		cout << "Test for queue #4 (avg of " << kNiter << " runs)" << endl;
-
-		cout << left << setw(kNsetwText) << "Size of empty queue: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeQueue4<int> )
-				<< " [bytes]" << endl;
-
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
+// Function to run the test for the lock-based queues with a lock of lock_policy.h
+template<typename Lock>
+void testLocks(const string &kName, const TestParameters &kPars) {
+	testQueue<ThreadSafeQueue1<int, std::allocator<int>, Lock>>(
+			"queue #1 (" + kName + ")", kPars);
+	testQueue<ThreadSafeQueue2<int, NodePoolAllocator<int>, CompactLayout, Lock>>(
+			"queue #2 (" + kName + ")", kPars);
+}
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 6)
+		usageMsg();
+
+	// Optional test parameters
+	const size_t kBatchSize = argc > 6 ? stoi(string(argv[6])) : 1; // number of elements per bulk PUSH or POP
+	const size_t kNwaitPopThreads = argc > 7 ? stoi(string(argv[7])) : 0; // number of POP threads blocking in waitPop
+	const bool kSweep = argc > 8 ? stoi(string(argv[8])) != 0 : false; // test every combination of the policies
+	const string kLock = argc > 9 ? string(argv[9]) : "mutex"; // lock of the lock-based queues
+	if (kLock != "mutex" && kLock != "mcs" && kLock != "ticket"
+			&& kLock != "spinpark" && kLock != "all")
+		usageMsg();
+
+	// Test parameters
+	const TestParameters kPars { static_cast<size_t>(stoi(string(argv[1]))),
+			static_cast<size_t>(stoi(string(argv[2]))),
+			static_cast<size_t>(stoi(string(argv[3]))),
+			static_cast<size_t>(stoi(string(argv[4]))),
+			static_cast<size_t>(stoi(string(argv[5]))), kBatchSize,
+			kNwaitPopThreads, kSweep, kLock };
+
+	cout << "Nelements: " << kPars.kNelements << endl;
+	cout << "NpushThreads: " << kPars.kNpushThreads << endl;
+	cout << "NpopThreads: " << kPars.kNpopThreads << endl;
+	cout << "TimeHeadStart [ms]: " << kPars.kTimeHeadStart << endl;
+	cout << "Niter: " << kPars.kNiter << endl;
+	cout << "BatchSize: " << kPars.kBatchSize << endl;
+	cout << "NwaitPopThreads: " << kPars.kNwaitPopThreads << endl;
+	cout << "Sweep: " << kPars.kSweep << endl;
+	cout << "Lock: " << kPars.kLock << endl;
+
+	// Memory footprint of a large backlog
+	const size_t kNqueued = 1000000;
+	typedef pmr::polymorphic_allocator<int> PmrAllocator;
+	testMemory<ThreadSafeQueue1<int, PmrAllocator>>("queue #1", kNqueued);
+	testMemory<ThreadSafeQueue2<int, PmrAllocator>>("queue #2", kNqueued);
+	testMemory<ThreadSafeQueue3<int, HazardPointers, CompactLayout, PmrAllocator>>(
+			"queue #3", kNqueued);
+
+	testQueue<ThreadSafeQueue1<int>>("queue #1", kPars);
+	if (kPars.kBatchSize > 1)
+		testQueue<ThreadSafeQueue1<int>, pushValuesBulk, popValuesBulk>(
+				"queue #1 (bulk)", kPars);
+	testQueue<ThreadSafeQueue2<int>>("queue #2", kPars);
+	testQueue<ThreadSafeQueue2<int, std::allocator<int>>>(
+			"queue #2 (std::allocator)", kPars);
+	testQueue<ThreadSafeQueue2<int, NodePoolAllocator<int>, PaddedLayout>>(
+			"queue #2 (padded)", kPars);
+	testQueue<ThreadSafeQueue3<int>>("queue #3", kPars);
+	testQueue<ThreadSafeQueue4<int>>("queue #4", kPars);
+	testQueue<ThreadSafeQueue3<int, HazardPointers, PaddedLayout>>(
+			"queue #3 (padded)", kPars);
+	testQueue<ThreadSafeQueue4<int, HazardPointers, PaddedLayout>>(
+			"queue #4 (padded)", kPars);
+	testQueue<ThreadSafeQueue3<int, EpochReclamation>>(
+			"queue #3 (epoch-based reclamation)", kPars);
+	testQueue<ThreadSafeQueue4<int, EpochReclamation>>(
+			"queue #4 (epoch-based reclamation)", kPars);
+	testQueue<
+			ThreadSafeQueue<int, ExchangePushStrict, HazardPointers,
+					std::allocator<int>, EventCount>>(
+			"queue #3 (exchange push)", kPars);
+	testQueue<
+			ThreadSafeQueue<int, ExchangePushRelaxed, HazardPointers,
+					std::allocator<int>, EventCount>>(
+			"queue #4 (exchange push)", kPars);
+	testQueue<ThreadSafeQueue7<int>>("queue #7", kPars);
+	// Nodes from a pool memory resource shared by the PUSH and POP threads
+	pmr::synchronized_pool_resource poolResource;
+	const pmr::polymorphic_allocator<int> kPoolAllocator(&poolResource);
+	testQueue<ThreadSafeQueue1<int, pmr::polymorphic_allocator<int>>>(
+			"queue #1 (pmr pool)", kPars, kPoolAllocator);
+	testQueue<ThreadSafeQueue2<int, pmr::polymorphic_allocator<int>>>(
+			"queue #2 (pmr pool)", kPars, kPoolAllocator);
+	testQueue<
+			ThreadSafeQueue3<int, HazardPointers, CompactLayout,
+					pmr::polymorphic_allocator<int>>>("queue #3 (pmr pool)",
+			kPars, kPoolAllocator);
+	testQueue<ThreadSafeQueue7<int, pmr::polymorphic_allocator<int>>>(
+			"queue #7 (pmr pool)", kPars, kPoolAllocator);
+	// Bounded queue is sized to hold all elements so that PUSH never blocks
+	testQueue<ThreadSafeQueue5<int>>("queue #5", kPars,
+			kPars.kNpushThreads * kPars.kNelements);
+	// Single-producer/single-consumer queue is only valid for 1 PUSH and 1 POP thread
+	if (kPars.kNpushThreads == 1 && kPars.kNpopThreads == 1)
+		testQueue<ThreadSafeQueue6<int>>("queue #6", kPars, kPars.kNelements);
+
+	// Mailbox: kNpushThreads PUSH threads and a single POP thread that drains all elements
+	TestParameters kMailboxPars(kPars);
+	kMailboxPars.kNpopThreads = 1;
+	kMailboxPars.kNwaitPopThreads = 0;
+	testQueue<ThreadSafeQueue2<int>, pushValues<ThreadSafeQueue2<int>>,
+			drainValues<ThreadSafeQueue2<int>>>("queue #2 (mailbox)",
+			kMailboxPars);
+	testQueue<
+			ThreadSafeQueue<int, ExchangePushRelaxed, HazardPointers,
+					NodePoolAllocator<int>, EventCount>,
+			pushValues<
+					ThreadSafeQueue<int, ExchangePushRelaxed, HazardPointers,
+							NodePoolAllocator<int>, EventCount>>,
+			drainValues<
+					ThreadSafeQueue<int, ExchangePushRelaxed, HazardPointers,
+							NodePoolAllocator<int>, EventCount>>>(
+			"queue #4 (exchange push, mailbox)", kMailboxPars);
+	// Small bounded queue, PUSH yields while the queue is full until the POP thread drains it
+	testQueue<ThreadSafeQueue5<int>, pushValues<ThreadSafeQueue5<int>>,
+			drainValues<ThreadSafeQueue5<int>>>("queue #5 (capacity 1024, mailbox)",
+			kMailboxPars, 1024);
+	typedef Mailbox<ThreadSafeQueue8<Message>> Mailbox8;
+	testQueue<Mailbox8, pushMessages, drainValues<Mailbox8>>(
+			"queue #8 (mailbox)", kMailboxPars,
+			kMailboxPars.kNpushThreads * kMailboxPars.kNelements);
+	// Intrusive queue with several POP threads
+	typedef Mailbox<ThreadSafeQueue9<Message>> Mailbox9;
+	testQueue<Mailbox9, pushMessages, popValues<Mailbox9>>("queue #9", kPars,
+			kPars.kNpushThreads * kPars.kNelements);
+	testQueue<Mailbox9, pushMessages, drainValues<Mailbox9>>(
+			"queue #9 (mailbox)", kMailboxPars,
+			kMailboxPars.kNpushThreads * kMailboxPars.kNelements);
+
+	// Lock-based queues with the selected lock (std::mutex is tested above)
+	if (kPars.kLock == "mcs" || kPars.kLock == "all")
+		testLocks<McsLock>("MCS lock", kPars);
+	if (kPars.kLock == "ticket" || kPars.kLock == "all")
+		testLocks<TicketLock>("ticket lock", kPars);
+	if (kPars.kLock == "spinpark" || kPars.kLock == "all")
+		testLocks<SpinThenParkLock>("spin-then-park lock", kPars);
+
+	// Combination matrix of the ThreadSafeQueue policies
+	if (kPars.kSweep) {
+		testAllocPolicies<SingleLock, ImmediateReclamation, ConditionWait>(
+				"single lock", kPars);
+		testAllocPolicies<TwoLocks, ImmediateReclamation, ConditionWait>(
+				"two locks", kPars);
+		testAllocPolicies<LockFreeStrict, HazardPointers, EventCount>(
+				"lock-free strict, hazard pointers", kPars);
+		testAllocPolicies<LockFreeStrict, EpochReclamation, EventCount>(
+				"lock-free strict, epoch-based reclamation", kPars);
+		testAllocPolicies<LockFreeRelaxed, HazardPointers, EventCount>(
+				"lock-free relaxed, hazard pointers", kPars);
+		testAllocPolicies<LockFreeRelaxed, EpochReclamation, EventCount>(
+				"lock-free relaxed, epoch-based reclamation", kPars);
+		testAllocPolicies<ExchangePushStrict, HazardPointers, EventCount>(
+				"exchange push strict, hazard pointers", kPars);
+		testAllocPolicies<ExchangePushRelaxed, EpochReclamation, EventCount>(
+				"exchange push relaxed, epoch-based reclamation", kPars);
 	}
 
 	return 0;
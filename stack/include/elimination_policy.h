@@ -0,0 +1,112 @@
+/*
+ * elimination_policy.h
+ *
+ * Elimination policies for the lock-free stacks. A push whose CAS on the head failed
+ * can offer its node in a slot of an elimination array and wait a few spins for a pop
+ * whose CAS failed too; the pop takes the node straight from the slot and neither of
+ * them touches the head again. A push and a pop cancel each other, so under a balanced
+ * load most of the contended operations never retry on the head.
+ *
+ * NoElimination            - failed CASes retry on the head
+ * EliminationBackoff<N, S> - N cache-line sized slots, a push waits S spins for a pop
+ *
+ * A node in a slot has never been on the stack, so the pop that takes it owns it
+ * exclusively and can free it without reclamation.
+ *
+ */
+
+#ifndef ELIMINATION_POLICY_H_
+#define ELIMINATION_POLICY_H_
+
+#include <atomic> // std::atomic
+#include <thread> // std::this_thread::get_id
+#include <functional> // std::hash
+#include <cstdint> // std::uint32_t
+#include <cstddef> // std::size_t
+
+struct NoElimination {
+	template<typename Node>
+	class Array {
+	public:
+		// true if a pop took the node
+		static constexpr bool offer(Node*) {
+			return false;
+		}
+		// a node offered by a push, or nullptr
+		static constexpr Node* take() {
+			return nullptr;
+		}
+	};
+};
+
+template<size_t kNslots = 8, size_t kNspins = 128>
+struct EliminationBackoff {
+	static_assert(kNslots > 0, "the elimination array needs a slot");
+
+	template<typename Node>
+	class Array {
+		static constexpr size_t kCacheLineSize = 64;
+
+		struct alignas(kCacheLineSize) Slot {
+			std::atomic<Node*> node { nullptr };
+		};
+	public:
+		Array() = default;
+		Array(const Array&) = delete;
+		Array& operator=(const Array&) = delete;
+		Array(Array&&) = delete;
+		Array& operator=(Array&&) = delete;
+
+		bool offer(Node *node);
+		Node* take();
+	private:
+		static Slot& randomSlot(Slot (&slots)[kNslots]);
+
+		Slot m_slots[kNslots];
+	};
+};
+
+// Publishes the node in a random free slot and waits for a pop to take it, the node is
+// withdrawn (false) if no pop came within kNspins or all tried slots were busy
+template<size_t kNslots, size_t kNspins>
+template<typename Node>
+bool EliminationBackoff<kNslots, kNspins>::Array<Node>::offer(Node *node) {
+	Slot &slot = randomSlot(m_slots);
+	Node *expected = nullptr;
+	if (!slot.node.compare_exchange_strong(expected, node,
+			std::memory_order_release, std::memory_order_relaxed))
+		return false;
+	for (size_t spin = 0; spin < kNspins; ++spin)
+		if (slot.node.load(std::memory_order_relaxed) != node)
+			return true;
+	expected = node;
+	return !slot.node.compare_exchange_strong(expected, nullptr,
+			std::memory_order_relaxed, std::memory_order_relaxed);
+}
+
+template<size_t kNslots, size_t kNspins>
+template<typename Node>
+Node* EliminationBackoff<kNslots, kNspins>::Array<Node>::take() {
+	Slot &slot = randomSlot(m_slots);
+	Node *node = slot.node.load(std::memory_order_relaxed);
+	if (node
+			&& slot.node.compare_exchange_strong(node, nullptr,
+					std::memory_order_acquire, std::memory_order_relaxed))
+		return node;
+	return nullptr;
+}
+
+// Per-thread xorshift sequence, so that the threads spread over the slots
+template<size_t kNslots, size_t kNspins>
+template<typename Node>
+typename EliminationBackoff<kNslots, kNspins>::template Array<Node>::Slot& EliminationBackoff<
+		kNslots, kNspins>::Array<Node>::randomSlot(Slot (&slots)[kNslots]) {
+	static thread_local std::uint32_t s_state = static_cast<std::uint32_t>(std::hash<
+			std::thread::id>()(std::this_thread::get_id())) | 1;
+	s_state ^= s_state << 13;
+	s_state ^= s_state >> 17;
+	s_state ^= s_state << 5;
+	return slots[s_state % kNslots];
+}
+
+#endif /* ELIMINATION_POLICY_H_ */
@@ -0,0 +1,108 @@
+/*
+ * event_count.h
+ *
+ * Event count for blocking pops on the lock-free containers. A consumer that found
+ * the container empty spins for a few more attempts, then registers as a waiter,
+ * reads the sequence counter, retries once more and parks on the counter
+ * (std::atomic::wait, a futex on Linux) until a producer bumps it.
+ *
+ * Producers only pay a fence and a load of the waiter count per push, the counter
+ * is bumped and notified only when a waiter is registered.
+ *
+ */
+
+#ifndef EVENT_COUNT_H_
+#define EVENT_COUNT_H_
+
+#include <atomic> // std::atomic, std::atomic_thread_fence
+#include <cstdint> // std::uint32_t
+#include <cstddef> // std::size_t
+
+class EventCount {
+	static constexpr size_t kNspins = 64; // retries before a consumer registers as a waiter
+public:
+	typedef std::uint32_t Key;
+	static constexpr bool kTimed = false; // no awaitUntil, std::atomic::wait has no deadline
+
+	EventCount();
+	EventCount(const EventCount&) = delete;
+	EventCount& operator=(const EventCount&) = delete;
+	EventCount(EventCount&&) = delete;
+	EventCount& operator=(EventCount&&) = delete;
+
+	// producer side, called after an element has been published
+	void notifyOne();
+	void notifyAll();
+	// consumer side, prepareWait must be followed by exactly one of cancelWait or wait
+	Key prepareWait();
+	void cancelWait();
+	void wait(Key key);
+
+	// Calls tryPop until it returns a non-empty result (std::optional or pointer):
+	// spins first, then parks between the attempts
+	template<typename TryPop>
+	auto await(TryPop &&tryPop) -> decltype(tryPop());
+private:
+	void notify(bool all);
+
+	std::atomic<Key> m_sequence;
+	std::atomic<Key> m_nwaiters;
+};
+
+inline EventCount::EventCount() :
+		m_sequence(0), m_nwaiters(0) {
+}
+
+inline void EventCount::notifyOne() {
+	notify(false);
+}
+
+inline void EventCount::notifyAll() {
+	notify(true);
+}
+
+inline void EventCount::notify(bool all) {
+	// pairs with the fence in prepareWait: either the waiter sees the published element
+	// on its retry, or the producer sees the waiter here
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!m_nwaiters.load(std::memory_order_relaxed))
+		return;
+	m_sequence.fetch_add(1, std::memory_order_release);
+	if (all)
+		m_sequence.notify_all();
+	else
+		m_sequence.notify_one();
+}
+
+inline EventCount::Key EventCount::prepareWait() {
+	m_nwaiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return m_sequence.load(std::memory_order_acquire);
+}
+
+inline void EventCount::cancelWait() {
+	m_nwaiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void EventCount::wait(Key key) {
+	// returns immediately if a producer has bumped the sequence since prepareWait
+	m_sequence.wait(key, std::memory_order_acquire);
+	m_nwaiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<typename TryPop>
+auto EventCount::await(TryPop &&tryPop) -> decltype(tryPop()) {
+	for (size_t spin = 0; spin < kNspins; ++spin)
+		if (auto result = tryPop())
+			return result;
+	for (;;) {
+		const Key key = prepareWait();
+		if (auto result = tryPop()) {
+			cancelWait();
+			return result;
+		}
+		wait(key);
+	}
+}
+
+#endif /* EVENT_COUNT_H_ */
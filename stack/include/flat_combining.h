@@ -0,0 +1,136 @@
+/*
+ * flat_combining.h
+ *
+ * Flat combiner for the lock-based containers. Instead of taking the lock for its own
+ * operation, a thread publishes a request (a pointer to the operation on its stack) in
+ * a publication slot and waits. Whichever thread gets the combiner lock runs all
+ * published requests in one pass over the slots, so the sequential container stays in
+ * the cache of the combining core and the lock changes hands once per batch instead of
+ * once per operation.
+ *
+ * A thread first tries a slot picked by the hash of its id and probes the others when
+ * that one is taken; if all slots are taken it runs its operation itself once it holds
+ * the lock. Exceptions thrown by an operation are rethrown in the thread that requested
+ * it. Operations must not block, the blocking pops of the containers wait outside.
+ *
+ */
+
+#ifndef FLAT_COMBINING_H_
+#define FLAT_COMBINING_H_
+
+#include <atomic> // std::atomic
+#include <exception> // std::exception_ptr, std::current_exception, std::rethrow_exception
+#include <thread> // std::this_thread::yield, std::this_thread::get_id
+#include <functional> // std::hash
+#include <type_traits> // std::remove_reference_t
+#include <cstddef> // std::size_t
+
+class FlatCombiner {
+	static constexpr size_t kCacheLineSize = 64;
+	static constexpr size_t kNslots = 64; // publication slots
+	static constexpr size_t kNspins = 64; // polls of the request before a waiter yields
+
+	struct Request {
+		void (*run)(void *operation);
+		void *operation;
+		std::exception_ptr error;
+		std::atomic<bool> done;
+	};
+
+	struct alignas(kCacheLineSize) Slot {
+		std::atomic<Request*> request { nullptr };
+	};
+public:
+	FlatCombiner();
+	FlatCombiner(const FlatCombiner&) = delete;
+	FlatCombiner& operator=(const FlatCombiner&) = delete;
+	FlatCombiner(FlatCombiner&&) = delete;
+	FlatCombiner& operator=(FlatCombiner&&) = delete;
+
+	// Runs operation() under the combiner lock, in this or in the combining thread,
+	// and returns once it is done
+	template<typename Operation>
+	void execute(Operation &&operation);
+private:
+	static void runRequest(Request &request);
+	Slot* publish(Request &request);
+	bool tryLock();
+	void unlock();
+	void combine();
+
+	alignas(kCacheLineSize) std::atomic<bool> m_locked;
+	Slot m_slots[kNslots];
+};
+
+inline FlatCombiner::FlatCombiner() :
+		m_locked(false) {
+}
+
+template<typename Operation>
+void FlatCombiner::execute(Operation &&operation) {
+	typedef std::remove_reference_t<Operation> OperationType;
+	Request request { [](void *operation) {
+		(*static_cast<OperationType*>(operation))();
+	}, &operation, nullptr, false };
+	const Slot *slot = publish(request);
+	for (size_t spin = 0; !request.done.load(std::memory_order_acquire);
+			++spin) {
+		if (tryLock()) {
+			if (!slot)
+				runRequest(request);
+			combine();
+			unlock();
+		} else if (spin >= kNspins) {
+			std::this_thread::yield();
+		}
+	}
+	if (request.error)
+		std::rethrow_exception(request.error);
+}
+
+inline void FlatCombiner::runRequest(Request &request) {
+	try {
+		request.run(request.operation);
+	} catch (...) {
+		request.error = std::current_exception();
+	}
+	request.done.store(true, std::memory_order_release);
+}
+
+// Returns the slot the request was published in, or nullptr if all slots are taken
+inline FlatCombiner::Slot* FlatCombiner::publish(Request &request) {
+	static thread_local const size_t s_first = std::hash<std::thread::id>()(
+			std::this_thread::get_id()) % kNslots;
+	for (size_t ind = 0; ind < kNslots; ++ind) {
+		Slot &slot = m_slots[(s_first + ind) % kNslots];
+		Request *expected = nullptr;
+		if (!slot.request.load(std::memory_order_relaxed)
+				&& slot.request.compare_exchange_strong(expected, &request,
+						std::memory_order_release, std::memory_order_relaxed))
+			return &slot;
+	}
+	return nullptr;
+}
+
+inline bool FlatCombiner::tryLock() {
+	return !m_locked.load(std::memory_order_relaxed)
+			&& !m_locked.exchange(true, std::memory_order_acquire);
+}
+
+inline void FlatCombiner::unlock() {
+	m_locked.store(false, std::memory_order_release);
+}
+
+// Runs the requests published in all slots, the caller holds the combiner lock
+inline void FlatCombiner::combine() {
+	for (Slot &slot : m_slots) {
+		Request *request = slot.request.load(std::memory_order_acquire);
+		if (!request)
+			continue;
+		// the slot is freed first, the request is gone once it is done
+		slot.request.store(nullptr, std::memory_order_relaxed);
+		runRequest(*request);
+	}
+}
+
+#endif /* FLAT_COMBINING_H_ */
@@ -0,0 +1,232 @@
+/*
+ * lock_policy.h
+ *
+ * Lock policies for the lock-based containers. Every lock is Lockable (lock, try_lock,
+ * unlock), so it works with std::lock_guard and std::unique_lock, and the containers
+ * wait on it with ConditionVariableFor<Lock> (std::condition_variable for std::mutex,
+ * std::condition_variable_any otherwise).
+ *
+ * std::mutex       - futex-based mutex, the default
+ * McsLock          - MCS queue lock, each waiter spins on its own node (FIFO handoff)
+ * TicketLock       - ticket lock, waiters spin on a shared counter (FIFO handoff)
+ * SpinThenParkLock - spins for a while, then parks on the lock word (std::atomic::wait)
+ *
+ * The spinning locks yield the core after kNspins polls, so they degrade gracefully
+ * when there are more threads than cores. McsLock takes its queue node from a small
+ * per-thread stack, so a thread may hold up to McsLock::kMaxNested MCS locks at a time
+ * and has to release them in reverse order of acquisition (as lock_guard does).
+ *
+ */
+
+#ifndef LOCK_POLICY_H_
+#define LOCK_POLICY_H_
+
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable, std::condition_variable_any
+#include <thread> // std::this_thread::yield
+#include <type_traits> // std::conditional_t, std::is_same_v
+#include <cassert> // assert
+#include <cstdint> // std::uint32_t
+#include <cstddef> // std::size_t
+
+template<typename Lock>
+using ConditionVariableFor = std::conditional_t<std::is_same_v<Lock, std::mutex>,
+std::condition_variable, std::condition_variable_any>;
+
+// Polls ready() until it returns true, yielding the core after kNspins polls
+template<typename Ready>
+void spinUntil(Ready &&ready) {
+	constexpr size_t kNspins = 128;
+	for (size_t spin = 0; !ready(); ++spin)
+		if (spin >= kNspins)
+			std::this_thread::yield();
+}
+
+class McsLock {
+	static constexpr size_t kCacheLineSize = 64;
+
+	struct alignas(kCacheLineSize) QueueNode {
+		std::atomic<QueueNode*> next;
+		std::atomic<bool> locked;
+	};
+public:
+	static constexpr size_t kMaxNested = 8; // MCS locks held by a thread at a time
+
+	McsLock();
+	McsLock(const McsLock&) = delete;
+	McsLock& operator=(const McsLock&) = delete;
+
+	void lock();
+	bool try_lock();
+	void unlock();
+private:
+	// per-thread stack of queue nodes, the top one belongs to the last acquisition
+	struct NodeStack {
+		QueueNode m_nodes[kMaxNested];
+		size_t m_depth;
+	};
+
+	static NodeStack& localNodes();
+	static QueueNode* pushNode();
+	static void popNode();
+
+	std::atomic<QueueNode*> m_tail;
+	QueueNode *m_holder; // node of the thread holding the lock, written by the holder
+};
+
+class TicketLock {
+public:
+	TicketLock();
+	TicketLock(const TicketLock&) = delete;
+	TicketLock& operator=(const TicketLock&) = delete;
+
+	void lock();
+	bool try_lock();
+	void unlock();
+private:
+	std::atomic<std::uint32_t> m_next_ticket;
+	std::atomic<std::uint32_t> m_now_serving;
+};
+
+class SpinThenParkLock {
+	static constexpr size_t kNspins = 128; // attempts before a thread parks
+	enum State : std::uint32_t {
+		kUnlocked = 0, kLocked = 1, kLockedWithWaiters = 2
+	};
+public:
+	SpinThenParkLock();
+	SpinThenParkLock(const SpinThenParkLock&) = delete;
+	SpinThenParkLock& operator=(const SpinThenParkLock&) = delete;
+
+	void lock();
+	bool try_lock();
+	void unlock();
+private:
+	std::atomic<std::uint32_t> m_state;
+};
+
+// McsLock
+
+inline McsLock::McsLock() :
+		m_tail(nullptr), m_holder(nullptr) {
+}
+
+inline McsLock::NodeStack& McsLock::localNodes() {
+	static thread_local NodeStack s_nodes { };
+	return s_nodes;
+}
+
+inline McsLock::QueueNode* McsLock::pushNode() {
+	NodeStack &nodes = localNodes();
+	assert(nodes.m_depth < kMaxNested && "too many nested MCS locks");
+	QueueNode *node = &nodes.m_nodes[nodes.m_depth++];
+	node->next.store(nullptr, std::memory_order_relaxed);
+	node->locked.store(true, std::memory_order_relaxed);
+	return node;
+}
+
+inline void McsLock::popNode() {
+	--localNodes().m_depth;
+}
+
+inline void McsLock::lock() {
+	QueueNode *node = pushNode();
+	QueueNode *prev = m_tail.exchange(node, std::memory_order_acq_rel);
+	if (prev) {
+		// queue up behind prev and spin on our own node until prev hands over
+		prev->next.store(node, std::memory_order_release);
+		spinUntil([node]() {
+			return !node->locked.load(std::memory_order_acquire);
+		});
+	}
+	m_holder = node;
+}
+
+inline bool McsLock::try_lock() {
+	QueueNode *node = pushNode();
+	QueueNode *expected = nullptr;
+	if (!m_tail.compare_exchange_strong(expected, node,
+			std::memory_order_acquire, std::memory_order_relaxed)) {
+		popNode();
+		return false;
+	}
+	m_holder = node;
+	return true;
+}
+
+inline void McsLock::unlock() {
+	QueueNode *node = m_holder;
+	QueueNode *next = node->next.load(std::memory_order_acquire);
+	if (!next) {
+		QueueNode *expected = node;
+		if (m_tail.compare_exchange_strong(expected, nullptr,
+				std::memory_order_release, std::memory_order_relaxed)) {
+			popNode();
+			return;
+		}
+		// a successor has swapped the tail but not linked itself yet
+		spinUntil([node, &next]() {
+			return (next = node->next.load(std::memory_order_acquire));
+		});
+	}
+	next->locked.store(false, std::memory_order_release);
+	popNode();
+}
+
+// TicketLock
+
+inline TicketLock::TicketLock() :
+		m_next_ticket(0), m_now_serving(0) {
+}
+
+inline void TicketLock::lock() {
+	const std::uint32_t ticket = m_next_ticket.fetch_add(1,
+			std::memory_order_relaxed);
+	spinUntil([this, ticket]() {
+		return m_now_serving.load(std::memory_order_acquire) == ticket;
+	});
+}
+
+inline bool TicketLock::try_lock() {
+	std::uint32_t ticket = m_now_serving.load(std::memory_order_relaxed);
+	return m_next_ticket.compare_exchange_strong(ticket, ticket + 1,
+			std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+inline void TicketLock::unlock() {
+	// only the holder writes m_now_serving
+	m_now_serving.store(m_now_serving.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+}
+
+// SpinThenParkLock
+
+inline SpinThenParkLock::SpinThenParkLock() :
+		m_state(kUnlocked) {
+}
+
+inline void SpinThenParkLock::lock() {
+	for (size_t spin = 0; spin < kNspins; ++spin)
+		if (try_lock())
+			return;
+	// announce a waiter, the unlocking thread then wakes one up
+	while (m_state.exchange(kLockedWithWaiters, std::memory_order_acquire)
+			!= kUnlocked)
+		m_state.wait(kLockedWithWaiters, std::memory_order_relaxed);
+}
+
+inline bool SpinThenParkLock::try_lock() {
+	std::uint32_t expected = kUnlocked;
+	return m_state.load(std::memory_order_relaxed) == kUnlocked
+			&& m_state.compare_exchange_strong(expected, kLocked,
+					std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+inline void SpinThenParkLock::unlock() {
+	if (m_state.exchange(kUnlocked, std::memory_order_release)
+			== kLockedWithWaiters)
+		m_state.notify_one();
+}
+
+#endif /* LOCK_POLICY_H_ */
@@ -0,0 +1,34 @@
+/*
+ * shrink_policy.h
+ *
+ * Shrink policies for the contiguous storage of a container. After a pop the
+ * container asks the policy for the capacity to shrink to (0 keeps the storage);
+ * shrinking reallocates and moves the remaining elements, so it trades a copy of the
+ * container for memory given back after a burst.
+ *
+ * NeverShrink           - the capacity only grows (reserve once, no reallocation)
+ * ShrinkWhenQuarterFull - halves the capacity when at most a quarter of it is used
+ *
+ */
+
+#ifndef SHRINK_POLICY_H_
+#define SHRINK_POLICY_H_
+
+#include <cstddef> // std::size_t
+
+struct NeverShrink {
+	static constexpr size_t shrinkCapacity(size_t, size_t) {
+		return 0;
+	}
+};
+
+struct ShrinkWhenQuarterFull {
+	static constexpr size_t kMinCapacity = 64; // smaller storage is never shrunk
+
+	static constexpr size_t shrinkCapacity(size_t size, size_t capacity) {
+		return capacity > kMinCapacity && size <= capacity / 4 ?
+				capacity / 2 : 0;
+	}
+};
+
+#endif /* SHRINK_POLICY_H_ */
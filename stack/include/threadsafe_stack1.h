@@ -1,26 +1,38 @@
 /*
  * threadsafe_stack1.h
  *
- * Lock-based thread-safe unbounded stack implemented using library stack,
+ * Lock-based thread-safe unbounded stack implemented using library vector,
  * locks, a single mutex, and a condition variable.
  *
+ * The elements are held by value in a contiguous std::vector using Allocator (an
+ * allocator that propagates itself to the element, e.g. std::pmr::polymorphic_allocator,
+ * also serves the element's own memory). Once the capacity is reserved, push and pop
+ * construct and move the element under the lock without allocating; ShrinkPolicy
+ * (shrink_policy.h) decides whether pops give memory back. Lock replaces std::mutex
+ * by a lock of lock_policy.h (the waiting pops then use std::condition_variable_any).
+ *
  */
 
 #ifndef THREADSAFE_STACK1_H_
 #define THREADSAFE_STACK1_H_
 
-#include <stack> // std::stack
-#include <memory> // std::unique_ptr
-#include <list> // std::list
-#include <utility> // std::move
+#include <memory> // std::unique_ptr, std::allocator
+#include <vector> // std::vector
+#include <utility> // std::move, std::move_if_noexcept
+#include <optional> // std::optional
+#include <algorithm> // std::min, std::max
 #include <mutex> // std::mutex, std::lock_guard, std::unique_lock
-#include <condition_variable> // std::condition_variable
+#include <condition_variable> // std::condition_variable, std::condition_variable_any
+#include <chrono> // std::chrono::duration, std::chrono::time_point, std::chrono::steady_clock
 #include <exception> // std::exception
+#include "shrink_policy.h" // NeverShrink, ShrinkWhenQuarterFull
+#include "lock_policy.h" // ConditionVariableFor
 
-template<typename Element>
+template<typename Element, typename Allocator = std::allocator<Element>,
+		typename ShrinkPolicy = NeverShrink, typename Lock = std::mutex>
 class ThreadSafeStack1 {
 	typedef std::unique_ptr<Element> ElementPtr;
-	typedef std::list<ElementPtr> Container;
+	typedef std::vector<Element, Allocator> Container;
 
 	struct EmptyStack: public std::exception {
 		virtual const char* what() const noexcept (true) override {
@@ -28,99 +40,290 @@ class ThreadSafeStack1 {
 		}
 	};
 public:
+	typedef Allocator allocator_type;
+
 	ThreadSafeStack1();
+	explicit ThreadSafeStack1(const Allocator &allocator);
+	// reserves capacity elements
+	explicit ThreadSafeStack1(size_t capacity, const Allocator &allocator =
+			Allocator());
 	~ThreadSafeStack1();
 	ThreadSafeStack1(const ThreadSafeStack1&) = delete;
 	ThreadSafeStack1& operator=(const ThreadSafeStack1&) = delete;
 	ThreadSafeStack1(ThreadSafeStack1&&) = delete;
 	ThreadSafeStack1& operator=(ThreadSafeStack1&&) = delete;
 
+	allocator_type get_allocator() const;
 	bool empty() const;
 	size_t size() const;
+	size_t capacity() const;
+	void reserve(size_t capacity);
+	void shrinkToFit();
 	void push(const Element &element);
 	void push(Element &&element);
 	template<typename ...Ts>
 	void emplace(Ts &&... pars);
 	ElementPtr waitPop();
+	template<typename Rep, typename Period>
+	ElementPtr waitPopFor(const std::chrono::duration<Rep, Period> &timeout);
+	template<typename Clock, typename Duration>
+	ElementPtr waitPopUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline);
 	ElementPtr tryPop();
+	Element waitPopValue();
+	template<typename Rep, typename Period>
+	std::optional<Element> waitPopValueFor(
+			const std::chrono::duration<Rep, Period> &timeout);
+	template<typename Clock, typename Duration>
+	std::optional<Element> waitPopValueUntil(
+			const std::chrono::time_point<Clock, Duration> &deadline);
+	std::optional<Element> tryPopValue();
+	template<typename InputIt>
+	void pushBulk(InputIt first, InputIt last);
+	template<typename OutputIt>
+	size_t popBulk(OutputIt out, size_t max_count);
 private:
-	mutable std::mutex m_mutex;
-	std::condition_variable m_cond;
-	std::stack<ElementPtr, Container> m_stack;
+	Element takeTop();
+	void shrink(size_t capacity);
+	void notify(size_t count);
+
+	mutable Lock m_mutex;
+	ConditionVariableFor<Lock> m_cond;
+	size_t m_nwaiters; // threads inside waitPop/waitPopUntil, guarded by m_mutex
+	Container m_stack; // the top of the stack is the back of the vector
 };
 
-template<typename Element>
-ThreadSafeStack1<Element>::ThreadSafeStack1() :
-		m_stack(std::stack<ElementPtr, Container>()) {
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ThreadSafeStack1() :
+		ThreadSafeStack1(Allocator()) {
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ThreadSafeStack1(
+		const Allocator &allocator) :
+		m_nwaiters(0), m_stack(allocator) {
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ThreadSafeStack1(
+		size_t capacity, const Allocator &allocator) :
+		ThreadSafeStack1(allocator) {
+	m_stack.reserve(capacity);
 }
 
-template<typename Element>
-ThreadSafeStack1<Element>::~ThreadSafeStack1() {
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::~ThreadSafeStack1() {
 }
 
-template<typename Element>
-bool ThreadSafeStack1<Element>::empty() const {
-	std::lock_guard<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+typename ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::allocator_type ThreadSafeStack1<
+		Element, Allocator, ShrinkPolicy, Lock>::get_allocator() const {
+	return m_stack.get_allocator();
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+bool ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::empty() const {
+	std::lock_guard<Lock> lock(m_mutex);
 	return m_stack.empty();
 }
 
-template<typename Element>
-size_t ThreadSafeStack1<Element>::size() const {
-	std::lock_guard<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+size_t ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::size() const {
+	std::lock_guard<Lock> lock(m_mutex);
 	return m_stack.size();
 }
 
-template<typename Element>
-void ThreadSafeStack1<Element>::push(const Element &element) {
-	ElementPtr new_element(std::make_unique<Element>(element));
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_stack.push(std::move(new_element));
-	}
-	m_cond.notify_one();
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+size_t ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::capacity() const {
+	std::lock_guard<Lock> lock(m_mutex);
+	return m_stack.capacity();
 }
 
-template<typename Element>
-void ThreadSafeStack1<Element>::push(Element &&element) {
-	ElementPtr new_element(std::make_unique<Element>(std::move(element)));
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_stack.push(std::move(new_element));
-	}
-	m_cond.notify_one();
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::reserve(
+		size_t capacity) {
+	std::lock_guard<Lock> lock(m_mutex);
+	m_stack.reserve(capacity);
 }
 
-template<typename Element>
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::shrinkToFit() {
+	std::lock_guard<Lock> lock(m_mutex);
+	shrink(m_stack.size());
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::push(
+		const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::push(
+		Element &&element) {
+	emplace(std::move(element));
+}
+
+// The element is constructed in place under the lock (no allocation within the reserved
+// capacity), a waiting thread is only notified if there is one (no futex call while
+// all consumers poll)
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
 template<typename ...Ts>
-void ThreadSafeStack1<Element>::emplace(Ts &&... pars) {
-	ElementPtr new_element(
-			std::make_unique<Element>(std::forward<Ts>(pars)...));
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::emplace(
+		Ts &&... pars) {
+	size_t count;
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_stack.push(std::move(new_element));
+		std::lock_guard<Lock> lock(m_mutex);
+		m_stack.emplace_back(std::forward<Ts>(pars)...);
+		count = std::min<size_t>(1, m_nwaiters);
 	}
-	m_cond.notify_one();
+	notify(count);
+}
+
+// Moves the top element out of the stack and applies the shrink policy,
+// the caller holds m_mutex
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+Element ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::takeTop() {
+	Element back_element(std::move(m_stack.back()));
+	m_stack.pop_back();
+	if (const size_t capacity = ShrinkPolicy::shrinkCapacity(m_stack.size(),
+			m_stack.capacity())) {
+		try {
+			shrink(capacity);
+		} catch (...) {
+			// shrinking is best-effort, the popped element must not be lost
+		}
+	}
+	return back_element;
+}
+
+// Reallocates the storage with the given capacity (at least the size), the caller
+// holds m_mutex; the stack is unchanged if an allocation or a copy throws
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::shrink(
+		size_t capacity) {
+	if (capacity >= m_stack.capacity())
+		return;
+	Container shrunk(m_stack.get_allocator());
+	shrunk.reserve(std::max(capacity, m_stack.size()));
+	for (Element &element : m_stack)
+		shrunk.push_back(std::move_if_noexcept(element));
+	m_stack.swap(shrunk);
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+typename ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ElementPtr ThreadSafeStack1<
+		Element, Allocator, ShrinkPolicy, Lock>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename Rep, typename Period>
+typename ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ElementPtr ThreadSafeStack1<
+		Element, Allocator, ShrinkPolicy, Lock>::waitPopFor(
+		const std::chrono::duration<Rep, Period> &timeout) {
+	return waitPopUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+// Returns a null pointer if the stack is still empty at the deadline
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename Clock, typename Duration>
+typename ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ElementPtr ThreadSafeStack1<
+		Element, Allocator, ShrinkPolicy, Lock>::waitPopUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline) {
+	std::optional<Element> back_element(waitPopValueUntil(deadline));
+	if (!back_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+typename ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::ElementPtr ThreadSafeStack1<
+		Element, Allocator, ShrinkPolicy, Lock>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
 }
 
-template<typename Element>
-typename ThreadSafeStack1<Element>::ElementPtr ThreadSafeStack1<Element>::waitPop() {
-	std::unique_lock<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+Element ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::waitPopValue() {
+	std::unique_lock<Lock> lock(m_mutex);
+	++m_nwaiters;
 	m_cond.wait(lock, [this]() -> bool {
 		return !this->m_stack.empty();
 	});
-	ElementPtr back_element(std::move(m_stack.top()));
-	m_stack.pop();
-	return back_element;
+	--m_nwaiters;
+	return takeTop();
 }
 
-template<typename Element>
-typename ThreadSafeStack1<Element>::ElementPtr ThreadSafeStack1<Element>::tryPop() {
-	std::lock_guard<std::mutex> lock(m_mutex);
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename Rep, typename Period>
+std::optional<Element> ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::waitPopValueFor(
+		const std::chrono::duration<Rep, Period> &timeout) {
+	return waitPopValueUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+// Returns an empty optional if the stack is still empty at the deadline
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename Clock, typename Duration>
+std::optional<Element> ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::waitPopValueUntil(
+		const std::chrono::time_point<Clock, Duration> &deadline) {
+	std::unique_lock<Lock> lock(m_mutex);
+	++m_nwaiters;
+	const bool ready = m_cond.wait_until(lock, deadline, [this]() -> bool {
+		return !this->m_stack.empty();
+	});
+	--m_nwaiters;
+	if (!ready)
+		return std::nullopt;
+	return takeTop();
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+std::optional<Element> ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::tryPopValue() {
+	std::lock_guard<Lock> lock(m_mutex);
 	if (m_stack.empty())
-		return ElementPtr(nullptr);
-	ElementPtr back_element(std::move(m_stack.top()));
-	m_stack.pop();
-	return back_element;
+		return std::nullopt;
+	return takeTop();
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename InputIt>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::pushBulk(
+		InputIt first, InputIt last) {
+	// take the lock and notify once for the whole batch
+	size_t count;
+	{
+		std::lock_guard<Lock> lock(m_mutex);
+		const size_t old_size = m_stack.size();
+		m_stack.insert(m_stack.end(), first, last);
+		count = std::min(m_stack.size() - old_size, m_nwaiters);
+	}
+	notify(count);
+}
+
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+template<typename OutputIt>
+size_t ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::popBulk(
+		OutputIt out, size_t max_count) {
+	std::lock_guard<Lock> lock(m_mutex);
+	size_t count = 0;
+	for (; count < max_count && !m_stack.empty(); ++count) {
+		*out = takeTop();
+		++out;
+	}
+	return count;
+}
+
+// Wakes up count waiting threads with a single notification
+template<typename Element, typename Allocator, typename ShrinkPolicy, typename Lock>
+void ThreadSafeStack1<Element, Allocator, ShrinkPolicy, Lock>::notify(
+		size_t count) {
+	if (count == 1)
+		m_cond.notify_one();
+	else if (count > 1)
+		m_cond.notify_all();
 }
 
 #endif /* THREADSAFE_STACK1_H_ */
@@ -2,24 +2,53 @@
  * threadsafe_stack3.h
  *
  * Lock-free thread-safe unbounded stack implemented using a singly-linked list,
- * and atomic operations with the relaxed memory models
+ * epoch-based reclamation, and atomic operations with the relaxed memory models
+ * (blocking pops spin, then park on an event count)
+ *
+ * The nodes are allocated with Allocator rebound to the node type and the elements
+ * are constructed with allocator_traits::construct (uses-allocator construction for
+ * std::pmr::polymorphic_allocator).
+ *
+ * With EliminationBackoff (elimination_policy.h) a push and a pop whose CAS on the
+ * head failed can cancel each other in an elimination array.
  *
  */
 
 #ifndef THREADSAFE_STACK3_H_
 #define THREADSAFE_STACK3_H_
 
-#include <memory> // std::shared_ptr, std::unique_ptr
+#include <memory> // std::unique_ptr, std::allocator, std::allocator_traits
 #include <utility> // std::move
-#include <atomic> // std::atomic, atomic_compare_exchange_weak, atomic_load
+#include <optional> // std::optional
+#include <type_traits> // std::aligned_storage
+#include <new> // placement new
+#include <atomic> // std::atomic
 #include <exception> // std::exception
+#include "event_count.h" // EventCount
+#include "epoch_reclamation.h" // EpochDomain
+#include "elimination_policy.h" // NoElimination
 
-template<typename Element>
+template<typename Element, typename Allocator = std::allocator<Element>,
+		typename EliminationPolicy = NoElimination>
 class ThreadSafeStack3 {
-	typedef std::shared_ptr<Element> ElementPtr;
-	typedef std::unique_ptr<Element> ElementUPtr;
-	class Node; // forward declaration
-	typedef std::shared_ptr<Node> NodePtr;
+	struct Node; // forward declaration
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Node> NodeAllocator;
+	typedef std::allocator_traits<NodeAllocator> NodeAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+
+	// Frees nodes that hold no element, the reclamation domain calls it for retired nodes
+	class NodeDeleter {
+	public:
+		explicit NodeDeleter(const NodeAllocator &allocator);
+		void operator()(Node *node);
+	private:
+		NodeAllocator m_allocator;
+	};
+
+	typedef EpochDomain<Node, NodeDeleter> Domain;
 
 	struct EmptyStack: public std::exception {
 		virtual const char* what() const noexcept (true) override {
@@ -27,95 +56,193 @@ class ThreadSafeStack3 {
 		}
 	};
 
+	// The element is constructed in place in the node by the stack (a single allocation
+	// per push) and destroyed by the thread that pops the node.
 	struct Node {
 		Node() :
-				m_data(nullptr), next(nullptr) {
-		}
-		Node(const Element &element) :
-				m_data(std::make_unique<Element>(element)), next(nullptr) {
-		}
-		Node(Element &&element) :
-				m_data(std::make_unique<Element>(std::move(element))), next(
-						nullptr) {
+				next(nullptr) {
 		}
 		~Node() = default;
-		ElementUPtr m_data;
-		NodePtr next;
+		Element* data() {
+			return reinterpret_cast<Element*>(&m_storage);
+		}
+		Node *next;
+		typename std::aligned_storage<sizeof(Element), alignof(Element)>::type m_storage;
 	};
 public:
+	typedef Allocator allocator_type;
+
 	ThreadSafeStack3();
+	explicit ThreadSafeStack3(const Allocator &allocator);
 	~ThreadSafeStack3();
 	ThreadSafeStack3(const ThreadSafeStack3&) = delete;
 	ThreadSafeStack3& operator=(const ThreadSafeStack3&) = delete;
 	ThreadSafeStack3(ThreadSafeStack3&&) = delete;
 	ThreadSafeStack3& operator=(ThreadSafeStack3&&) = delete;
 
+	allocator_type get_allocator() const;
 	bool empty() const;
 	void push(const Element &element);
 	void push(Element &&element);
 	template<typename ...Ts>
 	void emplace(Ts &&... pars);
+	std::unique_ptr<Element> waitPop();
 	std::unique_ptr<Element> tryPop();
+	Element waitPopValue();
+	std::optional<Element> tryPopValue();
 private:
-	NodePtr m_head;
+	template<typename ...Ts>
+	Node* createNode(Ts &&... pars);
+	void destroyNode(Node *node);
+	void pushNode(Node *new_node);
+
+	NodeAllocator m_allocator;
+	Domain m_domain;
+	EventCount m_event_count;
+	std::atomic<Node*> m_head;
+	typename EliminationPolicy::template Array<Node> m_elimination;
 };
 
-template<typename Element>
-ThreadSafeStack3<Element>::ThreadSafeStack3() :
-		m_head(nullptr) {
+template<typename Element, typename Allocator, typename EliminationPolicy>
+ThreadSafeStack3<Element, Allocator, EliminationPolicy>::NodeDeleter::NodeDeleter(
+		const NodeAllocator &allocator) :
+		m_allocator(allocator) {
 }
 
-template<typename Element>
-ThreadSafeStack3<Element>::~ThreadSafeStack3() {
+template<typename Element, typename Allocator, typename EliminationPolicy>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::NodeDeleter::operator()(Node *node) {
+	node->~Node();
+	NodeAllocatorTraits::deallocate(m_allocator, node, 1);
 }
 
-template<typename Element>
-bool ThreadSafeStack3<Element>::empty() const {
-	return !std::atomic_load_explicit(&m_head, std::memory_order_relaxed);
+template<typename Element, typename Allocator, typename EliminationPolicy>
+ThreadSafeStack3<Element, Allocator, EliminationPolicy>::ThreadSafeStack3() :
+		ThreadSafeStack3(Allocator()) {
 }
 
-template<typename Element>
-void ThreadSafeStack3<Element>::push(const Element &element) {
-	NodePtr new_node = std::make_shared<Node>(element);
-	new_node->next = std::atomic_load_explicit(&m_head,
-			std::memory_order_relaxed);
-	while (!std::atomic_compare_exchange_weak_explicit(&m_head, &new_node->next,
-			new_node, std::memory_order_relaxed, std::memory_order_relaxed))
-		;
+template<typename Element, typename Allocator, typename EliminationPolicy>
+ThreadSafeStack3<Element, Allocator, EliminationPolicy>::ThreadSafeStack3(
+		const Allocator &allocator) :
+		m_allocator(allocator), m_domain(NodeDeleter(m_allocator)), m_head(
+				nullptr) {
 }
 
-template<typename Element>
-void ThreadSafeStack3<Element>::push(Element &&element) {
-	NodePtr new_node = std::make_shared<Node>(std::move(element));
-	new_node->next = std::atomic_load_explicit(&m_head,
-			std::memory_order_relaxed);
-	while (!std::atomic_compare_exchange_weak_explicit(&m_head, &new_node->next,
-			new_node, std::memory_order_relaxed, std::memory_order_relaxed))
-		;
+template<typename Element, typename Allocator, typename EliminationPolicy>
+ThreadSafeStack3<Element, Allocator, EliminationPolicy>::~ThreadSafeStack3() {
+	Node *node = m_head.load(std::memory_order_relaxed);
+	while (node) {
+		Node *next = node->next;
+		destroyNode(node);
+		node = next;
+	}
 }
 
-template<typename Element>
+template<typename Element, typename Allocator, typename EliminationPolicy>
 template<typename ...Ts>
-void ThreadSafeStack3<Element>::emplace(Ts &&... pars) {
-	NodePtr new_node = std::make_shared<Node>(std::forward<Ts>(pars)...);
-	new_node->next = std::atomic_load_explicit(&m_head,
-			std::memory_order_relaxed);
-	while (!std::atomic_compare_exchange_weak_explicit(&m_head, &new_node->next,
-			new_node, std::memory_order_relaxed, std::memory_order_relaxed))
-		;
-}
-
-template<typename Element>
-std::unique_ptr<Element> ThreadSafeStack3<Element>::tryPop() {
-	NodePtr old_head = std::atomic_load_explicit(&m_head,
-			std::memory_order_relaxed);
+typename ThreadSafeStack3<Element, Allocator, EliminationPolicy>::Node* ThreadSafeStack3<Element,
+		Allocator, EliminationPolicy>::createNode(Ts &&... pars) {
+	Node *node = NodeAllocatorTraits::allocate(m_allocator, 1);
+	new (node) Node();
+	try {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::construct(allocator, node->data(),
+				std::forward<Ts>(pars)...);
+	} catch (...) {
+		node->~Node();
+		NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+// Destroys the element and frees a node that has not been popped
+template<typename Element, typename Allocator, typename EliminationPolicy>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::destroyNode(Node *node) {
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::destroy(allocator, node->data());
+	node->~Node();
+	NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+typename ThreadSafeStack3<Element, Allocator, EliminationPolicy>::allocator_type ThreadSafeStack3<
+		Element, Allocator, EliminationPolicy>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+bool ThreadSafeStack3<Element, Allocator, EliminationPolicy>::empty() const {
+	return !m_head.load(std::memory_order_relaxed);
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::push(const Element &element) {
+	pushNode(createNode(element));
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::push(Element &&element) {
+	pushNode(createNode(std::move(element)));
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+template<typename ...Ts>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::emplace(Ts &&... pars) {
+	pushNode(createNode(std::forward<Ts>(pars)...));
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+void ThreadSafeStack3<Element, Allocator, EliminationPolicy>::pushNode(Node *new_node) {
+	// push never dereferences a shared node, so it needs no critical section
+	new_node->next = m_head.load(std::memory_order_relaxed);
+	while (!m_head.compare_exchange_weak(new_node->next, new_node,
+			std::memory_order_release, std::memory_order_relaxed))
+		if (m_elimination.offer(new_node))
+			return; // a pop took the element, the stack is unchanged
+	m_event_count.notifyOne();
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+std::unique_ptr<Element> ThreadSafeStack3<Element, Allocator, EliminationPolicy>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+std::unique_ptr<Element> ThreadSafeStack3<Element, Allocator, EliminationPolicy>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return std::unique_ptr<Element>(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+Element ThreadSafeStack3<Element, Allocator, EliminationPolicy>::waitPopValue() {
+	return std::move(*m_event_count.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename Allocator, typename EliminationPolicy>
+std::optional<Element> ThreadSafeStack3<Element, Allocator, EliminationPolicy>::tryPopValue() {
+	typename Domain::Guard guard(m_domain);
+	// old_head cannot be freed (nor reused, so no ABA) while the guard is held
+	Node *old_head = guard.protect(0, m_head);
 	while (old_head
-			&& !std::atomic_compare_exchange_weak_explicit(&m_head, &old_head,
-					old_head->next, std::memory_order_relaxed,
-					std::memory_order_relaxed))
-		;
-	return old_head ?
-			std::move(old_head->m_data) : std::unique_ptr<Element>(nullptr);
+			&& !m_head.compare_exchange_weak(old_head, old_head->next,
+					std::memory_order_acquire, std::memory_order_acquire)) {
+		// a push that failed as well may hand its node over
+		if (Node *node = m_elimination.take()) {
+			std::optional<Element> back_element(std::move(*node->data()));
+			destroyNode(node);
+			return back_element;
+		}
+	}
+	if (!old_head)
+		return std::nullopt;
+	std::optional<Element> back_element(std::move(*old_head->data()));
+	old_head->data()->~Element();
+	guard.retire(old_head);
+	return back_element;
 }
 
 #endif /* THREADSAFE_STACK3_H_ */
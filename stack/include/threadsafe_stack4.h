@@ -0,0 +1,245 @@
+/*
+ * threadsafe_stack4.h
+ *
+ * Lock-free thread-safe unbounded stack implemented using a singly-linked list
+ * (Treiber), tagged pointers updated with a double-width (16-byte) CAS, a node
+ * freelist, and atomic operations with the acquire-release memory models
+ * (blocking pops spin, then park on an event count)
+ *
+ * The head is a {Node*, tag} pair whose tag is incremented on every successful CAS,
+ * so a pop whose head node was popped and pushed back in the meantime (ABA) fails.
+ * Popped nodes go to an internal freelist (a second tagged stack) and are reused
+ * by later pushes; nodes are only freed by the destructor, so a pop may read the
+ * link of a node that another thread has just popped. No reclamation scheme is needed.
+ *
+ * On x86-64 the 16-byte CAS is cmpxchg16b (built with -mcx16, libatomic selects it at
+ * run time; GCC still reports std::atomic<TaggedPtr> as not always lock-free).
+ *
+ */
+
+#ifndef THREADSAFE_STACK4_H_
+#define THREADSAFE_STACK4_H_
+
+#include <memory> // std::unique_ptr, std::allocator, std::allocator_traits
+#include <utility> // std::move
+#include <optional> // std::optional
+#include <type_traits> // std::aligned_storage
+#include <new> // placement new
+#include <atomic> // std::atomic
+#include <cstdint> // std::uint64_t
+#include <exception> // std::exception
+#include "event_count.h" // EventCount
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeStack4 {
+	struct Node; // forward declaration
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Node> NodeAllocator;
+	typedef std::allocator_traits<NodeAllocator> NodeAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+
+	struct EmptyStack: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty stack";
+		}
+	};
+
+	// The element is constructed in place in the node by the stack and destroyed by
+	// the thread that pops the node. The link is atomic because a stale pop may read
+	// it while the node is being reused.
+	struct Node {
+		Node() :
+				next(nullptr) {
+		}
+		~Node() = default;
+		Element* data() {
+			return reinterpret_cast<Element*>(&m_storage);
+		}
+		std::atomic<Node*> next;
+		typename std::aligned_storage<sizeof(Element), alignof(Element)>::type m_storage;
+	};
+
+	// Head of a list, the tag counts the successful updates of the head
+	struct alignas(16) TaggedPtr {
+		Node *ptr;
+		std::uint64_t tag;
+	};
+	typedef std::atomic<TaggedPtr> Head;
+public:
+	typedef Allocator allocator_type;
+
+	ThreadSafeStack4();
+	explicit ThreadSafeStack4(const Allocator &allocator);
+	~ThreadSafeStack4();
+	ThreadSafeStack4(const ThreadSafeStack4&) = delete;
+	ThreadSafeStack4& operator=(const ThreadSafeStack4&) = delete;
+	ThreadSafeStack4(ThreadSafeStack4&&) = delete;
+	ThreadSafeStack4& operator=(ThreadSafeStack4&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	std::unique_ptr<Element> waitPop();
+	std::unique_ptr<Element> tryPop();
+	Element waitPopValue();
+	std::optional<Element> tryPopValue();
+private:
+	static void pushList(Head &head, Node *node);
+	static Node* popList(Head &head);
+	static void freeList(NodeAllocator &allocator, Node *node);
+
+	template<typename ...Ts>
+	Node* createNode(Ts &&... pars);
+
+	NodeAllocator m_allocator;
+	EventCount m_event_count;
+	Head m_head;
+	Head m_free; // popped nodes that hold no element
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeStack4<Element, Allocator>::ThreadSafeStack4() :
+		ThreadSafeStack4(Allocator()) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack4<Element, Allocator>::ThreadSafeStack4(
+		const Allocator &allocator) :
+		m_allocator(allocator), m_head(TaggedPtr { nullptr, 0 }), m_free(
+				TaggedPtr { nullptr, 0 }) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack4<Element, Allocator>::~ThreadSafeStack4() {
+	ElementAllocator allocator(m_allocator);
+	for (Node *node = m_head.load(std::memory_order_relaxed).ptr; node;
+			node = node->next.load(std::memory_order_relaxed))
+		ElementAllocatorTraits::destroy(allocator, node->data());
+	freeList(m_allocator, m_head.load(std::memory_order_relaxed).ptr);
+	freeList(m_allocator, m_free.load(std::memory_order_relaxed).ptr);
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack4<Element, Allocator>::pushList(Head &head, Node *node) {
+	TaggedPtr old_head = head.load(std::memory_order_relaxed);
+	TaggedPtr new_head;
+	do {
+		node->next.store(old_head.ptr, std::memory_order_relaxed);
+		new_head = TaggedPtr { node, old_head.tag + 1 };
+	} while (!head.compare_exchange_weak(old_head, new_head,
+			std::memory_order_release, std::memory_order_relaxed));
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack4<Element, Allocator>::Node* ThreadSafeStack4<Element,
+		Allocator>::popList(Head &head) {
+	TaggedPtr old_head = head.load(std::memory_order_acquire);
+	while (old_head.ptr) {
+		// the node may have been popped (and reused) since the load, then the tag
+		// has changed and the CAS fails
+		const TaggedPtr new_head { old_head.ptr->next.load(
+				std::memory_order_relaxed), old_head.tag + 1 };
+		if (head.compare_exchange_weak(old_head, new_head,
+				std::memory_order_acquire, std::memory_order_acquire))
+			break;
+	}
+	return old_head.ptr;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack4<Element, Allocator>::freeList(NodeAllocator &allocator,
+		Node *node) {
+	while (node) {
+		Node *next = node->next.load(std::memory_order_relaxed);
+		node->~Node();
+		NodeAllocatorTraits::deallocate(allocator, node, 1);
+		node = next;
+	}
+}
+
+// Takes a node from the freelist (allocates one if it is empty) and constructs
+// the element in it
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+typename ThreadSafeStack4<Element, Allocator>::Node* ThreadSafeStack4<Element,
+		Allocator>::createNode(Ts &&... pars) {
+	Node *node = popList(m_free);
+	if (!node)
+		node = new (NodeAllocatorTraits::allocate(m_allocator, 1)) Node();
+	try {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::construct(allocator, node->data(),
+				std::forward<Ts>(pars)...);
+	} catch (...) {
+		pushList(m_free, node);
+		throw;
+	}
+	return node;
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack4<Element, Allocator>::allocator_type ThreadSafeStack4<
+		Element, Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeStack4<Element, Allocator>::empty() const {
+	return !m_head.load(std::memory_order_relaxed).ptr;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack4<Element, Allocator>::push(const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack4<Element, Allocator>::push(Element &&element) {
+	emplace(std::move(element));
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeStack4<Element, Allocator>::emplace(Ts &&... pars) {
+	pushList(m_head, createNode(std::forward<Ts>(pars)...));
+	m_event_count.notifyOne();
+}
+
+template<typename Element, typename Allocator>
+std::unique_ptr<Element> ThreadSafeStack4<Element, Allocator>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator>
+std::unique_ptr<Element> ThreadSafeStack4<Element, Allocator>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return std::unique_ptr<Element>(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
+}
+
+template<typename Element, typename Allocator>
+Element ThreadSafeStack4<Element, Allocator>::waitPopValue() {
+	return std::move(*m_event_count.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeStack4<Element, Allocator>::tryPopValue() {
+	Node *old_head = popList(m_head);
+	if (!old_head)
+		return std::nullopt;
+	std::optional<Element> back_element(std::move(*old_head->data()));
+	ElementAllocator allocator(m_allocator);
+	ElementAllocatorTraits::destroy(allocator, old_head->data());
+	pushList(m_free, old_head);
+	return back_element;
+}
+
+#endif /* THREADSAFE_STACK4_H_ */
@@ -0,0 +1,241 @@
+/*
+ * threadsafe_stack5.h
+ *
+ * Lock-free thread-safe unbounded stack implemented using a singly-linked list,
+ * split reference counting, and atomic operations with the acquire-release memory
+ * models (blocking pops spin, then park on an event count)
+ *
+ * The head is a counted node pointer {Node*, external count} updated with a double-width
+ * (16-byte) CAS. A pop first increments the external count of the head, which keeps the
+ * node alive while its link is read; the node also holds an internal count that the
+ * threads release their references to. The thread that unlinks the node folds the external
+ * count into the internal one, and the last thread to drop a reference frees the node.
+ * So nodes are freed as soon as the last pop that saw them is done, without a reclamation
+ * domain or a freelist.
+ *
+ */
+
+#ifndef THREADSAFE_STACK5_H_
+#define THREADSAFE_STACK5_H_
+
+#include <memory> // std::unique_ptr, std::allocator, std::allocator_traits
+#include <utility> // std::move
+#include <optional> // std::optional
+#include <type_traits> // std::aligned_storage
+#include <new> // placement new
+#include <atomic> // std::atomic
+#include <cstdint> // std::int64_t
+#include <exception> // std::exception
+#include "event_count.h" // EventCount
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeStack5 {
+	struct Node; // forward declaration
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Node> NodeAllocator;
+	typedef std::allocator_traits<NodeAllocator> NodeAllocatorTraits;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Element> ElementAllocator;
+	typedef std::allocator_traits<ElementAllocator> ElementAllocatorTraits;
+
+	struct EmptyStack: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty stack";
+		}
+	};
+
+	// Pointer to a node together with the number of threads that hold a reference
+	// taken through this pointer
+	struct alignas(16) CountedNodePtr {
+		Node *ptr;
+		std::int64_t external_count;
+	};
+
+	// The element is constructed in place in the node by the stack and moved out by
+	// the thread that unlinks the node. The link is written before the node is pushed.
+	struct Node {
+		Node() :
+				next { nullptr, 0 }, internal_count(0) {
+		}
+		~Node() = default;
+		Element* data() {
+			return reinterpret_cast<Element*>(&m_storage);
+		}
+		CountedNodePtr next;
+		std::atomic<std::int64_t> internal_count;
+		typename std::aligned_storage<sizeof(Element), alignof(Element)>::type m_storage;
+	};
+public:
+	typedef Allocator allocator_type;
+
+	ThreadSafeStack5();
+	explicit ThreadSafeStack5(const Allocator &allocator);
+	~ThreadSafeStack5();
+	ThreadSafeStack5(const ThreadSafeStack5&) = delete;
+	ThreadSafeStack5& operator=(const ThreadSafeStack5&) = delete;
+	ThreadSafeStack5(ThreadSafeStack5&&) = delete;
+	ThreadSafeStack5& operator=(ThreadSafeStack5&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	std::unique_ptr<Element> waitPop();
+	std::unique_ptr<Element> tryPop();
+	Element waitPopValue();
+	std::optional<Element> tryPopValue();
+private:
+	template<typename ...Ts>
+	Node* createNode(Ts &&... pars);
+	void destroyNode(Node *node);
+	void increaseHeadCount(CountedNodePtr &old_head);
+
+	NodeAllocator m_allocator;
+	EventCount m_event_count;
+	std::atomic<CountedNodePtr> m_head;
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeStack5<Element, Allocator>::ThreadSafeStack5() :
+		ThreadSafeStack5(Allocator()) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack5<Element, Allocator>::ThreadSafeStack5(
+		const Allocator &allocator) :
+		m_allocator(allocator), m_head(CountedNodePtr { nullptr, 0 }) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack5<Element, Allocator>::~ThreadSafeStack5() {
+	ElementAllocator allocator(m_allocator);
+	Node *node = m_head.load(std::memory_order_relaxed).ptr;
+	while (node) {
+		Node *next = node->next.ptr;
+		ElementAllocatorTraits::destroy(allocator, node->data());
+		destroyNode(node);
+		node = next;
+	}
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+typename ThreadSafeStack5<Element, Allocator>::Node* ThreadSafeStack5<Element,
+		Allocator>::createNode(Ts &&... pars) {
+	Node *node = new (NodeAllocatorTraits::allocate(m_allocator, 1)) Node();
+	try {
+		ElementAllocator allocator(m_allocator);
+		ElementAllocatorTraits::construct(allocator, node->data(),
+				std::forward<Ts>(pars)...);
+	} catch (...) {
+		destroyNode(node);
+		throw;
+	}
+	return node;
+}
+
+// Frees a node whose element has already been destroyed (or moved out)
+template<typename Element, typename Allocator>
+void ThreadSafeStack5<Element, Allocator>::destroyNode(Node *node) {
+	node->~Node();
+	NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+}
+
+// Takes a reference to the current head node, old_head is updated to the head
+// with the incremented external count
+template<typename Element, typename Allocator>
+void ThreadSafeStack5<Element, Allocator>::increaseHeadCount(
+		CountedNodePtr &old_head) {
+	CountedNodePtr new_head;
+	do {
+		new_head = old_head;
+		++new_head.external_count;
+	} while (!m_head.compare_exchange_strong(old_head, new_head,
+			std::memory_order_acquire, std::memory_order_relaxed));
+	old_head.external_count = new_head.external_count;
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack5<Element, Allocator>::allocator_type ThreadSafeStack5<
+		Element, Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeStack5<Element, Allocator>::empty() const {
+	return !m_head.load(std::memory_order_relaxed).ptr;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack5<Element, Allocator>::push(const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack5<Element, Allocator>::push(Element &&element) {
+	emplace(std::move(element));
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeStack5<Element, Allocator>::emplace(Ts &&... pars) {
+	// the pointer in the head holds the single reference of the stack
+	const CountedNodePtr new_node { createNode(std::forward<Ts>(pars)...), 1 };
+	new_node.ptr->next = m_head.load(std::memory_order_relaxed);
+	while (!m_head.compare_exchange_weak(new_node.ptr->next, new_node,
+			std::memory_order_release, std::memory_order_relaxed))
+		;
+	m_event_count.notifyOne();
+}
+
+template<typename Element, typename Allocator>
+std::unique_ptr<Element> ThreadSafeStack5<Element, Allocator>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator>
+std::unique_ptr<Element> ThreadSafeStack5<Element, Allocator>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return std::unique_ptr<Element>(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
+}
+
+template<typename Element, typename Allocator>
+Element ThreadSafeStack5<Element, Allocator>::waitPopValue() {
+	return std::move(*m_event_count.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeStack5<Element, Allocator>::tryPopValue() {
+	CountedNodePtr old_head = m_head.load(std::memory_order_relaxed);
+	while (true) {
+		increaseHeadCount(old_head);
+		Node *const node = old_head.ptr;
+		if (!node)
+			return std::nullopt;
+		if (m_head.compare_exchange_strong(old_head, node->next,
+				std::memory_order_relaxed, std::memory_order_relaxed)) {
+			// unlinked: the element is ours, hand the references of the other
+			// threads (all but the stack's and ours) over to the internal count
+			std::optional<Element> back_element(std::move(*node->data()));
+			ElementAllocator allocator(m_allocator);
+			ElementAllocatorTraits::destroy(allocator, node->data());
+			const std::int64_t count_increase = old_head.external_count - 2;
+			if (node->internal_count.fetch_add(count_increase,
+					std::memory_order_acq_rel) == -count_increase)
+				destroyNode(node);
+			return back_element;
+		}
+		// another thread unlinked the node (or changed the count), drop our reference;
+		// the release orders our read of the link before the free by the last thread
+		if (node->internal_count.fetch_add(-1, std::memory_order_acq_rel) == 1)
+			destroyNode(node);
+	}
+}
+
+#endif /* THREADSAFE_STACK5_H_ */
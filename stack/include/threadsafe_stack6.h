@@ -0,0 +1,164 @@
+/*
+ * threadsafe_stack6.h
+ *
+ * Flat-combining thread-safe unbounded stack implemented using library vector
+ * and a flat combiner (blocking pops spin, then park on an event count)
+ *
+ * Every operation is handed to FlatCombiner (flat_combining.h), which runs the pending
+ * operations of all threads in batches on the std::vector of stack #1, so the top of
+ * the stack stays in the cache of the combining thread.
+ *
+ */
+
+#ifndef THREADSAFE_STACK6_H_
+#define THREADSAFE_STACK6_H_
+
+#include <memory> // std::unique_ptr, std::allocator
+#include <vector> // std::vector
+#include <utility> // std::move
+#include <optional> // std::optional
+#include <exception> // std::exception
+#include "flat_combining.h" // FlatCombiner
+#include "event_count.h" // EventCount
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeStack6 {
+	typedef std::unique_ptr<Element> ElementPtr;
+	typedef std::vector<Element, Allocator> Container;
+
+	struct EmptyStack: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty stack";
+		}
+	};
+public:
+	typedef Allocator allocator_type;
+
+	ThreadSafeStack6();
+	explicit ThreadSafeStack6(const Allocator &allocator);
+	// reserves capacity elements
+	explicit ThreadSafeStack6(size_t capacity, const Allocator &allocator =
+			Allocator());
+	~ThreadSafeStack6();
+	ThreadSafeStack6(const ThreadSafeStack6&) = delete;
+	ThreadSafeStack6& operator=(const ThreadSafeStack6&) = delete;
+	ThreadSafeStack6(ThreadSafeStack6&&) = delete;
+	ThreadSafeStack6& operator=(ThreadSafeStack6&&) = delete;
+
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t size() const;
+	void push(const Element &element);
+	void push(Element &&element);
+	template<typename ...Ts>
+	void emplace(Ts &&... pars);
+	ElementPtr waitPop();
+	ElementPtr tryPop();
+	Element waitPopValue();
+	std::optional<Element> tryPopValue();
+private:
+	mutable FlatCombiner m_combiner;
+	EventCount m_event_count;
+	Container m_stack; // the top of the stack is the back of the vector
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeStack6<Element, Allocator>::ThreadSafeStack6() :
+		ThreadSafeStack6(Allocator()) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack6<Element, Allocator>::ThreadSafeStack6(
+		const Allocator &allocator) :
+		m_stack(allocator) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack6<Element, Allocator>::ThreadSafeStack6(size_t capacity,
+		const Allocator &allocator) :
+		ThreadSafeStack6(allocator) {
+	m_stack.reserve(capacity);
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack6<Element, Allocator>::~ThreadSafeStack6() {
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack6<Element, Allocator>::allocator_type ThreadSafeStack6<
+		Element, Allocator>::get_allocator() const {
+	return m_stack.get_allocator();
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeStack6<Element, Allocator>::empty() const {
+	bool is_empty;
+	m_combiner.execute([&]() {
+		is_empty = m_stack.empty();
+	});
+	return is_empty;
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeStack6<Element, Allocator>::size() const {
+	size_t count;
+	m_combiner.execute([&]() {
+		count = m_stack.size();
+	});
+	return count;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack6<Element, Allocator>::push(const Element &element) {
+	emplace(element);
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack6<Element, Allocator>::push(Element &&element) {
+	emplace(std::move(element));
+}
+
+template<typename Element, typename Allocator>
+template<typename ...Ts>
+void ThreadSafeStack6<Element, Allocator>::emplace(Ts &&... pars) {
+	m_combiner.execute([&]() {
+		m_stack.emplace_back(std::forward<Ts>(pars)...);
+	});
+	m_event_count.notifyOne();
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack6<Element, Allocator>::ElementPtr ThreadSafeStack6<
+		Element, Allocator>::waitPop() {
+	return std::make_unique<Element>(waitPopValue());
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack6<Element, Allocator>::ElementPtr ThreadSafeStack6<
+		Element, Allocator>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return ElementPtr(nullptr);
+	return std::make_unique<Element>(std::move(*back_element));
+}
+
+template<typename Element, typename Allocator>
+Element ThreadSafeStack6<Element, Allocator>::waitPopValue() {
+	return std::move(*m_event_count.await([this]() -> std::optional<Element> {
+		return this->tryPopValue();
+	}));
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeStack6<Element, Allocator>::tryPopValue() {
+	std::optional<Element> back_element;
+	m_combiner.execute([&]() {
+		if (m_stack.empty())
+			return;
+		back_element.emplace(std::move(m_stack.back()));
+		m_stack.pop_back();
+	});
+	return back_element;
+}
+
+#endif /* THREADSAFE_STACK6_H_ */
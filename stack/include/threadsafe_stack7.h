@@ -0,0 +1,107 @@
+/*
+ * threadsafe_stack7.h
+ *
+ * Intrusive lock-free thread-safe unbounded stack implemented using a singly-linked
+ * list of the elements themselves (Treiber), tagged pointers updated with a
+ * double-width (16-byte) CAS, and atomic operations with the acquire-release memory
+ * models (blocking pops spin, then park on an event count)
+ *
+ * An element derives from StackHook and is linked in place, so push and pop neither
+ * allocate nor copy, and pop hands back the very object that was pushed (e.g. a
+ * recycled buffer). The tagged head of stack #4 makes popping an element and pushing
+ * it back ABA-safe. A stale pop may still read the link of an element that another
+ * thread has just popped, so elements must stay alive as long as pops may run, as in
+ * a pool that recycles its objects; an element is in one stack at a time.
+ *
+ */
+
+#ifndef THREADSAFE_STACK7_H_
+#define THREADSAFE_STACK7_H_
+
+#include <atomic> // std::atomic
+#include <type_traits> // std::is_base_of_v
+#include <cstdint> // std::uint64_t
+#include "event_count.h" // EventCount
+
+struct StackHook {
+	std::atomic<StackHook*> next { nullptr };
+};
+
+template<typename Element>
+class ThreadSafeStack7 {
+	static_assert(std::is_base_of_v<StackHook, Element>,
+			"The element of the intrusive stack has to derive from StackHook");
+
+	// Head of the list, the tag counts the successful updates of the head
+	struct alignas(16) TaggedPtr {
+		StackHook *ptr;
+		std::uint64_t tag;
+	};
+public:
+	ThreadSafeStack7();
+	~ThreadSafeStack7();
+	ThreadSafeStack7(const ThreadSafeStack7&) = delete;
+	ThreadSafeStack7& operator=(const ThreadSafeStack7&) = delete;
+	ThreadSafeStack7(ThreadSafeStack7&&) = delete;
+	ThreadSafeStack7& operator=(ThreadSafeStack7&&) = delete;
+
+	bool empty() const;
+	void push(Element &element);
+	Element* waitPop();
+	Element* tryPop();
+private:
+	EventCount m_event_count;
+	std::atomic<TaggedPtr> m_head;
+};
+
+template<typename Element>
+ThreadSafeStack7<Element>::ThreadSafeStack7() :
+		m_head(TaggedPtr { nullptr, 0 }) {
+}
+
+template<typename Element>
+ThreadSafeStack7<Element>::~ThreadSafeStack7() {
+	// the elements still on the stack belong to the caller, nothing to release
+}
+
+template<typename Element>
+bool ThreadSafeStack7<Element>::empty() const {
+	return !m_head.load(std::memory_order_relaxed).ptr;
+}
+
+template<typename Element>
+void ThreadSafeStack7<Element>::push(Element &element) {
+	StackHook *hook = &element;
+	TaggedPtr old_head = m_head.load(std::memory_order_relaxed);
+	TaggedPtr new_head;
+	do {
+		hook->next.store(old_head.ptr, std::memory_order_relaxed);
+		new_head = TaggedPtr { hook, old_head.tag + 1 };
+	} while (!m_head.compare_exchange_weak(old_head, new_head,
+			std::memory_order_release, std::memory_order_relaxed));
+	m_event_count.notifyOne();
+}
+
+template<typename Element>
+Element* ThreadSafeStack7<Element>::waitPop() {
+	return m_event_count.await([this]() {
+		return this->tryPop();
+	});
+}
+
+template<typename Element>
+Element* ThreadSafeStack7<Element>::tryPop() {
+	TaggedPtr old_head = m_head.load(std::memory_order_acquire);
+	while (old_head.ptr) {
+		// the element may have been popped (and pushed back) since the load, then
+		// the tag has changed and the CAS fails
+		const TaggedPtr new_head { old_head.ptr->next.load(
+				std::memory_order_relaxed), old_head.tag + 1 };
+		if (m_head.compare_exchange_weak(old_head, new_head,
+				std::memory_order_acquire, std::memory_order_acquire))
+			return static_cast<Element*>(old_head.ptr);
+	}
+	return nullptr;
+}
+
+#endif /* THREADSAFE_STACK7_H_ */
@@ -0,0 +1,245 @@
+/*
+ * threadsafe_stack8.h
+ *
+ * Lock-free work-stealing deque (Chase-Lev) implemented using a growable power-of-two
+ * circular array, and atomic operations with the memory models of Le et al.,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013)
+ *
+ * The owner thread pushes and pops at the bottom (LIFO, a stack of its own that no
+ * other thread writes to), any thread steals at the top (FIFO). The owner and a thief
+ * only race for the last element, and thieves race with each other on the top index,
+ * so there is no shared head for all threads to contend on.
+ *
+ * push, tryPop and tryPopValue must only be called by the owner; steal, empty and size
+ * by any thread. steal returns nothing both when the deque is empty and when it lost
+ * the race for the top element to another thief or the owner, the caller then moves on
+ * to another victim. Elements are copied into the array with atomic stores, so they
+ * have to be trivially copyable (task pointers, indices). When the array is full the
+ * owner moves the elements into one twice the size; the old arrays are kept until the
+ * destructor because a thief may still read from them.
+ *
+ */
+
+#ifndef THREADSAFE_STACK8_H_
+#define THREADSAFE_STACK8_H_
+
+#include <memory> // std::unique_ptr, std::allocator, std::allocator_traits
+#include <optional> // std::optional
+#include <type_traits> // std::is_trivially_copyable_v
+#include <new> // placement new
+#include <atomic> // std::atomic, std::atomic_thread_fence
+#include <cstdint> // std::int64_t
+#include <exception> // std::exception
+
+template<typename Element, typename Allocator = std::allocator<Element>>
+class ThreadSafeStack8 {
+	static_assert(std::is_trivially_copyable_v<Element>,
+			"The work-stealing deque copies its elements with atomic stores");
+	static constexpr size_t kCacheLineSize = 64;
+	static constexpr size_t kMinCapacity = 32;
+
+	typedef std::atomic<Element> Slot;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Slot> SlotAllocator;
+	typedef std::allocator_traits<SlotAllocator> SlotAllocatorTraits;
+
+	struct EmptyStack: public std::exception {
+		virtual const char* what() const noexcept (true) override {
+			return "Empty stack";
+		}
+	};
+
+	// Circular array, the element at index pos is in slot pos & mask
+	struct Array {
+		Array *retired; // the array this one replaced, still readable by thieves
+		size_t mask;
+		Slot *slots;
+
+		Element get(std::int64_t pos) const {
+			return slots[pos & mask].load(std::memory_order_relaxed);
+		}
+		void put(std::int64_t pos, const Element &element) {
+			slots[pos & mask].store(element, std::memory_order_relaxed);
+		}
+	};
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+			Array> ArrayAllocator;
+	typedef std::allocator_traits<ArrayAllocator> ArrayAllocatorTraits;
+public:
+	typedef Allocator allocator_type;
+
+	ThreadSafeStack8();
+	explicit ThreadSafeStack8(const Allocator &allocator);
+	// allocates the array for capacity elements (rounded up to a power of two)
+	explicit ThreadSafeStack8(size_t capacity, const Allocator &allocator =
+			Allocator());
+	~ThreadSafeStack8();
+	ThreadSafeStack8(const ThreadSafeStack8&) = delete;
+	ThreadSafeStack8& operator=(const ThreadSafeStack8&) = delete;
+	ThreadSafeStack8(ThreadSafeStack8&&) = delete;
+	ThreadSafeStack8& operator=(ThreadSafeStack8&&) = delete;
+
+	// any thread
+	allocator_type get_allocator() const;
+	bool empty() const;
+	size_t size() const;
+	std::optional<Element> steal();
+	// owner side only
+	void push(const Element &element);
+	std::unique_ptr<Element> tryPop();
+	std::optional<Element> tryPopValue();
+private:
+	Array* createArray(size_t capacity, Array *retired);
+	void destroyArray(Array *array);
+	Array* grow(Array *array, std::int64_t top, std::int64_t bottom);
+
+	ArrayAllocator m_allocator;
+	// thieves' cache line
+	alignas(kCacheLineSize) std::atomic<std::int64_t> m_top;
+	// owner's cache line
+	alignas(kCacheLineSize) std::atomic<std::int64_t> m_bottom;
+	std::atomic<Array*> m_array;
+};
+
+template<typename Element, typename Allocator>
+ThreadSafeStack8<Element, Allocator>::ThreadSafeStack8() :
+		ThreadSafeStack8(Allocator()) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack8<Element, Allocator>::ThreadSafeStack8(
+		const Allocator &allocator) :
+		ThreadSafeStack8(kMinCapacity, allocator) {
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack8<Element, Allocator>::ThreadSafeStack8(size_t capacity,
+		const Allocator &allocator) :
+		m_allocator(allocator), m_top(0), m_bottom(0), m_array(nullptr) {
+	size_t rounded = 2;
+	while (rounded < capacity)
+		rounded <<= 1;
+	m_array.store(createArray(rounded, nullptr), std::memory_order_relaxed);
+}
+
+template<typename Element, typename Allocator>
+ThreadSafeStack8<Element, Allocator>::~ThreadSafeStack8() {
+	Array *array = m_array.load(std::memory_order_relaxed);
+	while (array) {
+		Array *retired = array->retired;
+		destroyArray(array);
+		array = retired;
+	}
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack8<Element, Allocator>::Array* ThreadSafeStack8<Element,
+		Allocator>::createArray(size_t capacity, Array *retired) {
+	SlotAllocator slot_allocator(m_allocator);
+	Slot *slots = SlotAllocatorTraits::allocate(slot_allocator, capacity);
+	for (size_t ind = 0; ind < capacity; ++ind)
+		new (&slots[ind]) Slot();
+	Array *array = ArrayAllocatorTraits::allocate(m_allocator, 1);
+	return new (array) Array { retired, capacity - 1, slots };
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack8<Element, Allocator>::destroyArray(Array *array) {
+	SlotAllocator slot_allocator(m_allocator);
+	SlotAllocatorTraits::deallocate(slot_allocator, array->slots,
+			array->mask + 1);
+	ArrayAllocatorTraits::deallocate(m_allocator, array, 1);
+}
+
+// Copies the elements between top and bottom into an array twice the size, the old
+// array stays valid for the thieves that loaded it
+template<typename Element, typename Allocator>
+typename ThreadSafeStack8<Element, Allocator>::Array* ThreadSafeStack8<Element,
+		Allocator>::grow(Array *array, std::int64_t top, std::int64_t bottom) {
+	Array *new_array = createArray(2 * (array->mask + 1), array);
+	for (std::int64_t pos = top; pos < bottom; ++pos)
+		new_array->put(pos, array->get(pos));
+	m_array.store(new_array, std::memory_order_release);
+	return new_array;
+}
+
+template<typename Element, typename Allocator>
+typename ThreadSafeStack8<Element, Allocator>::allocator_type ThreadSafeStack8<
+		Element, Allocator>::get_allocator() const {
+	return allocator_type(m_allocator);
+}
+
+template<typename Element, typename Allocator>
+bool ThreadSafeStack8<Element, Allocator>::empty() const {
+	return size() == 0;
+}
+
+template<typename Element, typename Allocator>
+size_t ThreadSafeStack8<Element, Allocator>::size() const {
+	const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const std::int64_t top = m_top.load(std::memory_order_relaxed);
+	return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template<typename Element, typename Allocator>
+void ThreadSafeStack8<Element, Allocator>::push(const Element &element) {
+	const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const std::int64_t top = m_top.load(std::memory_order_acquire);
+	Array *array = m_array.load(std::memory_order_relaxed);
+	if (bottom - top > static_cast<std::int64_t>(array->mask))
+		array = grow(array, top, bottom);
+	array->put(bottom, element);
+	// publishes the element to the thieves that read the new bottom (Le et al. use a
+	// release fence followed by a relaxed store, the same instructions on x86)
+	m_bottom.store(bottom + 1, std::memory_order_release);
+}
+
+template<typename Element, typename Allocator>
+std::unique_ptr<Element> ThreadSafeStack8<Element, Allocator>::tryPop() {
+	std::optional<Element> back_element(tryPopValue());
+	if (!back_element)
+		return std::unique_ptr<Element>(nullptr);
+	return std::make_unique<Element>(*back_element);
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeStack8<Element, Allocator>::tryPopValue() {
+	const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	Array *array = m_array.load(std::memory_order_relaxed);
+	// claim the bottom element first, a thief that reads the top afterwards sees it
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t top = m_top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		// empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return std::nullopt;
+	}
+	std::optional<Element> back_element(array->get(bottom));
+	if (top == bottom) {
+		// last element, race the thieves for it on the top index
+		if (!m_top.compare_exchange_strong(top, top + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed))
+			back_element.reset();
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return back_element;
+}
+
+template<typename Element, typename Allocator>
+std::optional<Element> ThreadSafeStack8<Element, Allocator>::steal() {
+	std::int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return std::nullopt;
+	// the element is read before the CAS, a successful CAS proves it was not taken
+	const Element front_element = m_array.load(std::memory_order_acquire)->get(
+			top);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+			std::memory_order_relaxed))
+		return std::nullopt;
+	return front_element;
+}
+
+#endif /* THREADSAFE_STACK8_H_ */
@@ -1,5 +1,5 @@
 //============================================================================
-// Script for testing the performance of three implementations of thread-safe stack
+// Script for testing the performance of eight implementations of thread-safe stack
 //============================================================================
 
 #include <iostream>
@@ -12,42 +12,205 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <functional>
 #include <numeric>
 #include <cmath>
+#include <atomic>
+#include <optional>
+#include <memory_resource>
 #include "timer.h"
 #include "threadsafe_stack1.h"
 #include "threadsafe_stack2.h"
 #include "threadsafe_stack3.h"
+#include "threadsafe_stack4.h"
+#include "threadsafe_stack5.h"
+#include "threadsafe_stack6.h"
+#include "threadsafe_stack7.h"
+#include "threadsafe_stack8.h"
 using namespace std;
 
 void usageMsg(void) {
 	string separator(50, '-');
 	ostringstream msg;
 	msg << separator << endl;
-	msg << "Usage: ./threadsafe_stack_test kNelements kNpushThreads kNpopThreads kTimeHeadStart kNiter" << endl << endl;
+	msg << "Usage: ./threadsafe_stack_test kNelements kNpushThreads kNpopThreads kTimeHeadStart kNiter [kBatchSize [kNwaitPopThreads [kLock]]]" << endl << endl;
 	msg << "Where: " << endl;
 	msg << "kNelements = number of elements to be PUSHed or POPed" << endl;
 	msg << "kNpushThreads = number of data preparation threads (PUSH thread)" << endl;
 	msg << "kNpopThreads = number of data processing threads (POP thread)" << endl;
 	msg << "kTimeHeadStart = head start in [ms] for data processing threads" << endl;
 	msg << "kNiter = number of test runs (iterations)" << endl;
+	msg << "kBatchSize = number of elements per bulk PUSH or POP (optional, default 1)" << endl;
+	msg << "kNwaitPopThreads = number of POP threads blocking in waitPop instead of polling with tryPop (optional, default 0)" << endl;
+	msg << "kLock = lock of the lock-based stack #1: mutex, mcs, ticket, spinpark or all (optional, default mutex)" << endl;
 	msg << separator << endl;
 	msg << "aborting.." << endl;
 	cerr << msg.str() << endl;
 	terminate();
 }
 
+// Test parameters
+struct TestParameters {
+	size_t kNelements; // number of elements to be PUSHed or POPed
+	size_t kNpushThreads; // number of data preparation threads (PUSH thread)
+	size_t kNpopThreads; // number of data processing threads (POP thread)
+	size_t kTimeHeadStart; // head start in [ms] for data processing threads
+	size_t kNiter; // number of test runs (iterations)
+	size_t kBatchSize; // number of elements per bulk PUSH or POP
+	size_t kNwaitPopThreads; // number of POP threads blocking in waitPop instead of polling with tryPop
+	string kLock; // lock of the lock-based stack: mutex, mcs, ticket, spinpark or all
+};
+
 // Function to PUSH the number of elements (kNelements) onto the stack
 template<typename T>
-void pushValues(T &stack, const size_t kNelements) {
-	for (size_t ind = 0; ind < kNelements; ++ind)
+void pushValues(T &stack, const TestParameters &kPars) {
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
 		stack.push(ind);
 }
+// Function to POP one element off the stack, by value if the stack supports it
+template<typename T>
+auto popValue(T &stack, int) -> decltype(stack.tryPopValue()) {
+	return stack.tryPopValue();
+}
+template<typename T>
+auto popValue(T &stack, long) -> decltype(stack.tryPop()) {
+	return stack.tryPop();
+}
 // Function to POOP the number of elements (kNelements) off the stack
 template<typename T>
-void popValues(T &stack, const size_t kNelements) {
-	for (size_t ind = 0; ind < kNelements; ++ind)
-		stack.tryPop();
+void popValues(T &stack, const TestParameters &kPars) {
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
+		popValue(stack, 0);
+}
+// Function to POP one element off the stack, blocking while it is empty if the stack supports a timed wait.
+// The timeout ends the wait if the PUSH threads run out of elements for the POP threads.
+const auto kWaitPopTimeout = chrono::milliseconds(100);
+template<typename T>
+auto waitPopValue(T &stack, int) -> decltype(stack.waitPopValueFor(kWaitPopTimeout)) {
+	return stack.waitPopValueFor(kWaitPopTimeout);
+}
+template<typename T>
+auto waitPopValue(T &stack, long) -> decltype(stack.waitPopFor(kWaitPopTimeout)) {
+	return stack.waitPopFor(kWaitPopTimeout);
+}
+template<typename T>
+auto waitPopValue(T &stack, ...) -> decltype(popValue(stack, 0)) {
+	return popValue(stack, 0);
+}
+// Function to POOP the number of elements (kNelements) off the stack, blocking while it is empty
+template<typename T>
+void waitPopValues(T &stack, const TestParameters &kPars) {
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind)
+		waitPopValue(stack, 0);
+}
+// Function to PUSH the number of elements (kNelements) onto the stack in batches (kBatchSize)
+template<typename T>
+void pushValuesBulk(T &stack, const TestParameters &kPars) {
+	vector<int> batch;
+	batch.reserve(kPars.kBatchSize);
+	for (size_t ind = 0; ind < kPars.kNelements; ind += batch.size()) {
+		batch.clear();
+		for (size_t batchInd = 0;
+				batchInd < kPars.kBatchSize && ind + batchInd < kPars.kNelements;
+				++batchInd)
+			batch.push_back(ind + batchInd);
+		stack.pushBulk(batch.begin(), batch.end());
+	}
+}
+// Function to POOP the number of elements (kNelements) off the stack in batches (kBatchSize)
+template<typename T>
+void popValuesBulk(T &stack, const TestParameters &kPars) {
+	vector<int> batch;
+	batch.reserve(kPars.kBatchSize);
+	for (size_t ind = 0; ind < kPars.kNelements; ind += kPars.kBatchSize) {
+		batch.clear();
+		stack.popBulk(back_inserter(batch),
+				min(kPars.kBatchSize, kPars.kNelements - ind));
+	}
+}
+
+// Function to PUSH and POP the number of elements (kNelements) in turns (50/50 mixed operations,
+// the stack stays small as in an object pool)
+template<typename T>
+void pushPopValues(T &stack, const TestParameters &kPars) {
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind) {
+		stack.push(ind);
+		popValue(stack, 0);
+	}
+}
+
+// Buffer of the intrusive stack #7, it embeds the link of the stack
+struct Buffer: public StackHook {
+	size_t value;
+};
+// Pool of recycled buffers, one per PUSH and POP thread so that a POP never waits
+struct BufferPool {
+	explicit BufferPool(size_t nbuffers) :
+			buffers(nbuffers) {
+		for (Buffer &buffer : buffers)
+			stack.push(buffer);
+	}
+	Buffer* tryPop() {
+		return stack.tryPop();
+	}
+
+	ThreadSafeStack7<Buffer> stack;
+	vector<Buffer> buffers;
+};
+// Function to POP a buffer off the pool, use it and PUSH it back, the number of elements (kNelements) times
+void recycleBuffers(BufferPool &pool, const TestParameters &kPars) {
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind) {
+		Buffer *buffer = pool.stack.waitPop();
+		buffer->value = ind;
+		pool.stack.push(*buffer);
+	}
+}
+
+// Work-stealing deque #8 shared by its owner (the single PUSH thread) and the thieves (the POP threads),
+// every element has to be taken exactly once, by the owner or by a thief
+struct WorkDeque {
+	explicit WorkDeque(size_t nelements) :
+			nelements(nelements) {
+	}
+	~WorkDeque() {
+		const size_t kNtaken = npopped.load(memory_order_relaxed)
+				+ nstolen.load(memory_order_relaxed);
+		if (kNtaken != nelements) {
+			cerr << "stack #8: " << kNtaken << " elements taken out of "
+					<< nelements << endl;
+			terminate();
+		}
+	}
+
+	ThreadSafeStack8<int> deque;
+	const size_t nelements; // elements PUSHed by the owner
+	atomic<size_t> npopped { 0 }; // elements POPped by the owner
+	atomic<size_t> nstolen { 0 }; // elements STOLEN by all thieves
+	atomic<bool> done { false }; // set by the owner once its deque is drained
+};
+// Function for the owner to PUSH the number of elements (kNelements) and to POP every second one back,
+// then to POP what the thieves have left
+void ownValues(WorkDeque &work, const TestParameters &kPars) {
+	size_t npopped = 0;
+	for (size_t ind = 0; ind < kPars.kNelements; ++ind) {
+		work.deque.push(ind);
+		if (ind % 2 && work.deque.tryPopValue())
+			++npopped;
+	}
+	while (work.deque.tryPopValue())
+		++npopped;
+	work.npopped.store(npopped, memory_order_relaxed);
+	work.done.store(true, memory_order_release);
+}
+// Function for a thief to STEAL elements until the owner is done
+void stealValues(WorkDeque &work, const TestParameters&) {
+	size_t nstolen = 0;
+	while (!work.done.load(memory_order_acquire))
+		if (work.deque.steal())
+			++nstolen;
+		else
+			this_thread::yield();
+	work.nstolen.fetch_add(nstolen, memory_order_relaxed);
 }
 
 // Function to calculate mean and std dev of test run timings
@@ -71,10 +234,16 @@ string calcMeanStd(const vector<size_t> &results) {
 	return os.str();
 }
 
-int main(int argc, char *argv[]) {
-
-	if (argc < 6)
-		usageMsg();
+// Function to run the test (kNiter runs) for a stack and report the result,
+// kPushValues and kPopValues are run by the PUSH and POP threads (kWaitPopValues by the
+// first kNwaitPopThreads POP threads), pars are forwarded to the constructor of the stack
+template<typename Stack,
+		void (*kPushValues)(Stack&, const TestParameters&) = pushValues<Stack>,
+		void (*kPopValues)(Stack&, const TestParameters&) = popValues<Stack>,
+		void (*kWaitPopValues)(Stack&, const TestParameters&) = waitPopValues<Stack>,
+		typename ...Ts>
+void testStack(const string &kName, const TestParameters &kPars,
+		const Ts &... pars) {
 
 	// Timer
 	Timer timer;
@@ -84,159 +253,166 @@ int main(int argc, char *argv[]) {
 	const size_t kNsetwText = 25;
 	const size_t kNsetwNumber = 10;
 
-	// Test parameters
-	const size_t kNelements = stoi(string(argv[1])); // number of elements to be PUSHed or POPed
-	const size_t kNpushThreads = stoi(string(argv[2])); // number of data preparation threads (PUSH thread)
-	const size_t kNpopThreads = stoi(string(argv[3])); // number of data processing threads (POP thread)
-	const size_t kTimeHeadStart = stoi(string(argv[4])); // head start in [ms] for data processing threads
-	const size_t kNiter = stoi(string(argv[5])); // number of test runs (iterations)
 	vector<size_t> results; // container of results (timings of all test runs)
 	vector<std::thread> threads; // container of threads
 
-	cout << "Nelements: " << kNelements << endl;
-	cout << "NpushThreads: " << kNpushThreads << endl;
-	cout << "NpopThreads: " << kNpopThreads << endl;
-	cout << "TimeHeadStart [ms]: " << kTimeHeadStart << endl;
-	cout << "Niter: " << kNiter << endl;
-	
-	{
-		// Test for stack #1
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeStack1<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
-
-		// Report result
-		cout << separator << endl;
-		cout << "Test for stack #1 (avg of " << kNiter << " runs)" << endl;
-
-		cout << left << setw(kNsetwText) << "Size of empty stack: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeStack1<int> )
-				<< " [bytes]" << endl;
-
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
+	for (size_t iterNo = 0; iterNo < kPars.kNiter; ++iterNo) {
+		Stack q(pars...);
+
+		timer.start();
+		// Spawn data preparation threads
+		for (size_t ind = 0; ind < kPars.kNpushThreads; ++ind)
+			threads.push_back(
+					std::thread(kPushValues, std::reference_wrapper<Stack>(q),
+							std::cref(kPars)));
+
+		// Head start for data preparation threads
+		this_thread::sleep_for(chrono::milliseconds(kPars.kTimeHeadStart));
+
+		// Spawn data processing threads, the first kNwaitPopThreads of them block in waitPop
+		for (size_t threadNo = 0; threadNo < kPars.kNpopThreads; ++threadNo)
+			threads.push_back(
+					std::thread(
+							threadNo < kPars.kNwaitPopThreads ?
+									kWaitPopValues : kPopValues,
+							std::reference_wrapper<Stack>(q), std::cref(kPars)));
+
+		// Wait till we are done
+		std::for_each(threads.begin(), threads.end(),
+				std::mem_fn(&std::thread::join));
+
+		timer.stop();
+		threads.clear();
+		results.push_back(timer.duration() - kPars.kTimeHeadStart);
 	}
 
-	{
-		// Test for stack #2
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeStack2<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
+	// Report result
+	cout << separator << endl;
+	cout << "Test for " << kName << " (avg of " << kPars.kNiter << " runs)"
+			<< endl;
 
-		// Report result
-		cout << separator << endl;
-		cout << "Test for stack #2 (avg of " << kNiter << " runs)" << endl;
+	cout << left << setw(kNsetwText) << "Size of empty stack: "
+			<< setw(kNsetwNumber) << sizeof(Stack) << " [bytes]" << endl;
 
-		cout << left << setw(kNsetwText) << "Size of empty stack: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeStack2<int> )
-				<< " [bytes]" << endl;
+	cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
+			<< calcMeanStd(results) << " [ms]" << endl;
+	cout << separator << endl;
+}
 
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
-	}
+// Function to run the test for the lock-based stack with a lock of lock_policy.h
+template<typename Lock>
+void testLocks(const string &kName, const TestParameters &kPars) {
+	typedef ThreadSafeStack1<int, allocator<int>, NeverShrink, Lock> Stack;
+	testStack<Stack>("stack #1 (" + kName + ")", kPars);
+	TestParameters kMixedPars(kPars);
+	kMixedPars.kNwaitPopThreads = 0;
+	testStack<Stack, pushPopValues, pushPopValues>(
+			"stack #1 (mixed, " + kName + ")", kMixedPars);
+}
 
-	{
-		// Test for stack #3
-		results.clear();
-		for (size_t iterNo = 0; iterNo < kNiter; ++iterNo) {
-			ThreadSafeStack3<int> q;
-
-			timer.start();
-			// Spawn data preparation threads
-			for (size_t ind = 0; ind < kNpushThreads; ++ind)
-				threads.push_back(
-						std::thread(pushValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Head start for data preparation threads
-			this_thread::sleep_for(chrono::milliseconds(kTimeHeadStart));
-
-			// Spawn data processing threads
-			for (size_t threadNo = 0; threadNo < kNpopThreads; ++threadNo)
-				threads.push_back(
-						std::thread(popValues<decltype(q)>,
-								std::reference_wrapper<decltype(q)>(q),
-								kNelements));
-
-			// Wait till we are done
-			std::for_each(threads.begin(), threads.end(),
-					std::mem_fun_ref(&std::thread::join));
-
-			timer.stop();
-			threads.clear();
-			results.push_back(timer.duration() - kTimeHeadStart);
-		}
+int main(int argc, char *argv[]) {
 
-		// Report result
-		cout << separator << endl;
-		cout << "Test for stack #3 (avg of " << kNiter << " runs)" << endl;
+	if (argc < 6)
+		usageMsg();
 
-		cout << left << setw(kNsetwText) << "Size of empty stack: "
-				<< setw(kNsetwNumber) << sizeof(ThreadSafeStack3<int> )
-				<< " [bytes]" << endl;
+	// Optional test parameters
+	const size_t kBatchSize = argc > 6 ? stoi(string(argv[6])) : 1; // number of elements per bulk PUSH or POP
+	const size_t kNwaitPopThreads = argc > 7 ? stoi(string(argv[7])) : 0; // number of POP threads blocking in waitPop
+	const string kLock = argc > 8 ? string(argv[8]) : "mutex"; // lock of the lock-based stack
+	if (kLock != "mutex" && kLock != "mcs" && kLock != "ticket"
+			&& kLock != "spinpark" && kLock != "all")
+		usageMsg();
 
-		cout << setw(kNsetwText) << "Test duration: " << setw(kNsetwNumber)
-				<< calcMeanStd(results) << " [ms]" << endl;
-		cout << separator << endl;
-	}
+	// Test parameters
+	const TestParameters kPars { static_cast<size_t>(stoi(string(argv[1]))),
+			static_cast<size_t>(stoi(string(argv[2]))),
+			static_cast<size_t>(stoi(string(argv[3]))),
+			static_cast<size_t>(stoi(string(argv[4]))),
+			static_cast<size_t>(stoi(string(argv[5]))), kBatchSize,
+			kNwaitPopThreads, kLock };
+
+	cout << "Nelements: " << kPars.kNelements << endl;
+	cout << "NpushThreads: " << kPars.kNpushThreads << endl;
+	cout << "NpopThreads: " << kPars.kNpopThreads << endl;
+	cout << "TimeHeadStart [ms]: " << kPars.kTimeHeadStart << endl;
+	cout << "Niter: " << kPars.kNiter << endl;
+	cout << "BatchSize: " << kPars.kBatchSize << endl;
+	cout << "NwaitPopThreads: " << kPars.kNwaitPopThreads << endl;
+	cout << "Lock: " << kPars.kLock << endl;
+
+	testStack<ThreadSafeStack1<int>>("stack #1", kPars);
+	if (kPars.kBatchSize > 1)
+		testStack<ThreadSafeStack1<int>, pushValuesBulk, popValuesBulk>(
+				"stack #1 (bulk)", kPars);
+	// Storage reserved for all elements so that PUSH never reallocates
+	testStack<ThreadSafeStack1<int>>("stack #1 (reserved)", kPars,
+			kPars.kNpushThreads * kPars.kNelements);
+	testStack<ThreadSafeStack1<int, allocator<int>, ShrinkWhenQuarterFull>>(
+			"stack #1 (shrinking)", kPars);
+	testStack<ThreadSafeStack2<int>>("stack #2", kPars);
+	testStack<ThreadSafeStack3<int>>("stack #3", kPars);
+	testStack<ThreadSafeStack4<int>>("stack #4", kPars);
+	testStack<ThreadSafeStack5<int>>("stack #5", kPars);
+	testStack<ThreadSafeStack6<int>>("stack #6", kPars);
+	testStack<ThreadSafeStack2<int, allocator<int>, EliminationBackoff<>>>(
+			"stack #2 (elimination)", kPars);
+	testStack<ThreadSafeStack3<int, allocator<int>, EliminationBackoff<>>>(
+			"stack #3 (elimination)", kPars);
+
+	// Every PUSH and POP thread pushes and pops in turns, the contended operations
+	// are eliminated in pairs (no thread blocks in waitPop, the stack is mostly empty)
+	TestParameters kMixedPars(kPars);
+	kMixedPars.kNwaitPopThreads = 0;
+	testStack<ThreadSafeStack1<int>, pushPopValues, pushPopValues>(
+			"stack #1 (mixed)", kMixedPars);
+	testStack<ThreadSafeStack2<int>, pushPopValues, pushPopValues>(
+			"stack #2 (mixed)", kMixedPars);
+	testStack<ThreadSafeStack2<int, allocator<int>, EliminationBackoff<>>,
+			pushPopValues, pushPopValues>("stack #2 (mixed, elimination)", kMixedPars);
+	testStack<ThreadSafeStack3<int>, pushPopValues, pushPopValues>(
+			"stack #3 (mixed)", kMixedPars);
+	testStack<ThreadSafeStack3<int, allocator<int>, EliminationBackoff<>>,
+			pushPopValues, pushPopValues>("stack #3 (mixed, elimination)", kMixedPars);
+	testStack<ThreadSafeStack4<int>, pushPopValues, pushPopValues>(
+			"stack #4 (mixed)", kMixedPars);
+	testStack<ThreadSafeStack5<int>, pushPopValues, pushPopValues>(
+			"stack #5 (mixed)", kMixedPars);
+	testStack<ThreadSafeStack6<int>, pushPopValues, pushPopValues>(
+			"stack #6 (mixed)", kMixedPars);
+	testStack<BufferPool, recycleBuffers, recycleBuffers>(
+			"stack #7 (mixed, buffer pool)", kMixedPars,
+			kMixedPars.kNpushThreads + kMixedPars.kNpopThreads);
+
+	// Work stealing: one owner PUSHes and POPs at the bottom, kNpopThreads thieves STEAL at the top
+	TestParameters kStealPars(kPars);
+	kStealPars.kNpushThreads = 1;
+	kStealPars.kNwaitPopThreads = 0;
+	testStack<WorkDeque, ownValues, stealValues, stealValues>(
+			"stack #8 (work stealing)", kStealPars, kStealPars.kNelements);
+
+	// Lock-based stack with the selected lock (std::mutex is tested above)
+	if (kPars.kLock == "mcs" || kPars.kLock == "all")
+		testLocks<McsLock>("MCS lock", kPars);
+	if (kPars.kLock == "ticket" || kPars.kLock == "all")
+		testLocks<TicketLock>("ticket lock", kPars);
+	if (kPars.kLock == "spinpark" || kPars.kLock == "all")
+		testLocks<SpinThenParkLock>("spin-then-park lock", kPars);
+
+	// Nodes from a pool memory resource shared by the PUSH and POP threads
+	pmr::synchronized_pool_resource poolResource;
+	const pmr::polymorphic_allocator<int> kPoolAllocator(&poolResource);
+	testStack<ThreadSafeStack1<int, pmr::polymorphic_allocator<int>>>(
+			"stack #1 (pmr pool)", kPars, kPoolAllocator);
+	testStack<ThreadSafeStack2<int, pmr::polymorphic_allocator<int>>>(
+			"stack #2 (pmr pool)", kPars, kPoolAllocator);
+	testStack<ThreadSafeStack3<int, pmr::polymorphic_allocator<int>>>(
+			"stack #3 (pmr pool)", kPars, kPoolAllocator);
+	testStack<ThreadSafeStack4<int, pmr::polymorphic_allocator<int>>>(
+			"stack #4 (pmr pool)", kPars, kPoolAllocator);
+	testStack<ThreadSafeStack5<int, pmr::polymorphic_allocator<int>>>(
+			"stack #5 (pmr pool)", kPars, kPoolAllocator);
+	testStack<ThreadSafeStack6<int, pmr::polymorphic_allocator<int>>>(
+			"stack #6 (pmr pool)", kPars, kPoolAllocator);
 
 	return 0;
 }
-